@@ -0,0 +1,39 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <cstdint>
+#include <print>
+#include <string_view>
+
+#include "generator.h"
+
+const int64_t INTERVAL = 100;
+
+// One rotation per line, "L68" or "R5", with 1 to 999 clicks
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  rng_t rng(seed);
+  while (out.size() < size) {
+    out << (rng.chance(1, 2) ? 'L' : 'R') << rng.uniform(1, 999) << '\n';
+  }
+}
+
+// Turn the dial one click at a time, counting every time it points at 0
+static void reference(std::string_view input) {
+  int64_t dial{50};
+  int64_t answer{0};
+  for (auto line : lines(input)) {
+    if (line.empty()) {
+      continue;
+    }
+    const int64_t step = line[0] == 'L' ? INTERVAL - 1 : 1;
+    int64_t clicks{0};
+    read_int(line, clicks);
+    for (; clicks > 0; --clicks) {
+      dial = (dial + step) % INTERVAL;
+      answer += dial == 0;
+    }
+  }
+  std::println("Answer: {}", answer);
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
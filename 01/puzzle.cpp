@@ -1,36 +1,183 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <charconv>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <print>
 #include <locale>
+#include <numeric>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "bench.h"
+#include "fast_input.h"
+#include "parallel.h"
+
+const long INTERVAL = 100;
+
+// Turn the dial by `rotation` clicks (negative means left) and return how many
+// times it pointed at 0 while doing so.
+long turn_dial(long &dial, long rotation) {
+  long answer = std::abs(rotation / INTERVAL);
+  rotation = rotation % INTERVAL;
+  dial += rotation;
+  if (dial != rotation && /* if dial was 0, don't count it twice */
+          dial <= 0 ||
+      dial >= 100) {
+    ++answer;
+  }
+  dial = (INTERVAL + dial) % INTERVAL;
+  assert(dial >= 0);
+  return answer;
+}
+
+// SWAR (SIMD within a register) parser: 8 input bytes are classified and
+// converted at once, so a rotation costs a couple of loads and multiplies
+// instead of a getline and a strtol.
+namespace swar {
+// Number of leading decimal digits in the 8 bytes of chunk, loaded from
+// memory in order, 8 means that there might be more.
+inline int digits(uint64_t chunk) {
+  const uint64_t values = chunk ^ (ONES * '0'); // '0'..'9' become 0..9
+  const uint64_t non_digit = ((values + ONES * (0x80 - 10)) | values) & HIGH_BITS;
+  return non_digit == 0 ? 8 : std::countr_zero(non_digit) / 8;
+}
+
+// Value of the first n_digits (1 to 7) digits of chunk
+inline long value(uint64_t chunk, int n_digits) {
+  uint64_t v = (chunk << (8 * (8 - n_digits))) & (ONES * 0x0F);
+  v = (v * (10 * 256 + 1)) >> 8;
+  v = ((v & 0x00FF00FF00FF00FFull) * (100 * 65536 + 1)) >> 16;
+  v = ((v & 0x0000FFFF0000FFFFull) * (10000ull * 4294967296ull + 1)) >> 32;
+  return static_cast<long>(v);
+}
+} // namespace swar
+
+// Parse the rotation that starts at `it`, i.e. "L68" or "R5", and move `it` past
+// its line terminator.
+inline long parse_rotation(const char *&it, const char *end) {
+  const bool left = *it++ == 'L';
+  long rotation{};
+  if constexpr (std::endian::native == std::endian::little) {
+    if (end - it >= 8) {
+      const auto chunk = swar::load(it);
+      const auto n_digits = swar::digits(chunk);
+      if (n_digits > 0 && n_digits < 8) {
+        rotation = swar::value(chunk, n_digits);
+        it += n_digits;
+      }
+    }
+  }
+  if (rotation == 0) { // tail of the buffer, very long numbers or plain 0
+    it = std::from_chars(it, end, rotation).ptr;
+  }
+  while (it != end && (*it == '\n' || *it == '\r')) {
+    ++it;
+  }
+  return left ? -rotation : rotation;
+}
+
+// floor(a / INTERVAL), also for negative a
+inline long floor_div(long a) {
+  return a / INTERVAL - (a % INTERVAL < 0);
+}
+
+// Zero crossings of a chunk of rotations as a function of the dial position
+// the chunk starts from, plus the net rotation of the chunk.
+//
+// Following the dial without wrapping it, position p points at 0 whenever p is
+// a multiple of INTERVAL. A right rotation from p to q counts the multiples in
+// (p, q] and a left one those in [q, p), which is exactly what turn_dial
+// counts, "dial was 0" case included. Both are a difference of floor_div
+// terms, and as the start position s goes from 0 to INTERVAL - 1 each term
+// floor_div(s + c) is a constant plus a unit step, so the whole chunk is
+// summarised by a difference array over s.
+struct chunk_summary {
+  long offset{};                       // net rotation, in [0, INTERVAL)
+  std::array<long, INTERVAL> zeros{}; // crossings for each start position
+
+  explicit chunk_summary(std::string_view rotations) {
+    long base{};
+    std::array<long, INTERVAL + 1> steps{};
+    auto add_term = [&base, &steps](long c, long sign) {
+      const auto q = floor_div(c);
+      base += sign * q;
+      steps[static_cast<std::size_t>(INTERVAL - (c - q * INTERVAL))] += sign;
+    };
+    long position{};
+    const char *it = rotations.data();
+    const char *end = it + rotations.size();
+    while (it != end) {
+      const auto rotation = parse_rotation(it, end);
+      if (rotation > 0) {
+        add_term(position + rotation, 1);
+        add_term(position, -1);
+      } else if (rotation < 0) {
+        add_term(position - 1, 1);
+        add_term(position + rotation - 1, -1);
+      }
+      position += rotation;
+    }
+    offset = position - floor_div(position) * INTERVAL;
+    // steps[INTERVAL] collects the terms that never step up
+    std::inclusive_scan(steps.cbegin(), std::prev(steps.cend()), zeros.begin(),
+                        std::plus<>(), base);
+  }
+};
+
+// Split the rotations in one chunk per core at line boundaries, summarise the
+// chunks concurrently and then chain them: an exclusive scan of the offsets
+// gives the dial position each chunk starts from.
+long count_zeros(std::string_view rotations, long &dial) {
+  const auto chunks =
+      split_chunks(rotations, n_workers(rotations.size(), 1uz << 20), '\n');
+
+  std::vector<chunk_summary> summaries(chunks.size(), chunk_summary({}));
+  parallel_for(chunks.size(), [&summaries, &chunks](std::size_t i) {
+    summaries[i] = chunk_summary(chunks[i]);
+  });
+
+  std::vector<long> starts(summaries.size());
+  std::transform_exclusive_scan(
+      summaries.cbegin(), summaries.cend(), starts.begin(), dial,
+      [](long a, long b) { return (a + b) % INTERVAL; },
+      [](const chunk_summary &summary) { return summary.offset; });
+  long answer{};
+  for (auto i = 0uz; i < summaries.size(); ++i) {
+    answer += summaries[i].zeros[static_cast<std::size_t>(starts[i])];
+  }
+  if (!summaries.empty()) {
+    dial = (starts.back() + summaries.back().offset) % INTERVAL;
+  }
+  return answer;
+}
 
 int main(){
   std::println("Ciao, {}!", "Mondo");
-  const int INTERVAL = 100;
+  phase_timer timer;
   long dial{50};
   long answer{};
-  std::string cl{}; // current line
-  while(std::getline(std::cin, cl)){
-    // int rotation;
-    // std::from_chars()
-    auto rotation = std::strtol(cl.c_str()+1, nullptr, 10);
-    if( cl[0] == 'L'){
-      rotation *= -1;
-    }
-    answer += std::abs(rotation/INTERVAL);
-    rotation = rotation % INTERVAL;
-    dial += rotation;
-    if( dial != rotation && /* if dial was 0, don't count it twice */
-        dial <= 0 ||
-        dial >= 100){
-      ++answer;
+  mapped_input input(STDIN_FILENO);
+  timer.lap("map");
+  if (!input.empty()) {
+    answer = count_zeros(input.view(), dial);
+  } else {
+    std::string cl{}; // current line
+    while(std::getline(std::cin, cl)){
+      // int rotation;
+      // std::from_chars()
+      auto rotation = std::strtol(cl.c_str()+1, nullptr, 10);
+      if( cl[0] == 'L'){
+        rotation *= -1;
+      }
+      answer += turn_dial(dial, rotation);
     }
-    dial = (INTERVAL + dial) % INTERVAL;
-    // if(dial == 0){ ++answer; }
-    if(dial < 0)
-      std::cout << dial << std::endl;
   }
+  timer.lap("solve");
   std::cout << "Answer: " << answer << std::endl;
 }
@@ -0,0 +1,135 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "generator.h"
+
+const uint64_t MAX_ID = 999'999'999'999'999'999; // 18 digits
+const int64_t MAX_MARGIN = 500;
+const uint64_t RANGE_BYTES = 24; // about, with the comma
+const uint64_t OVERLAP_ODDS = 16;
+
+// Smallest number >= n made of one block of its digits repeated, e.g. 123123
+static uint64_t next_repeated(uint64_t n, rng_t &rng) {
+  const auto digits = std::to_string(n);
+  std::vector<std::size_t> blocks;
+  for (auto block = 1uz; block < digits.size(); ++block) {
+    if (digits.size() % block == 0) {
+      blocks.push_back(block);
+    }
+  }
+  if (blocks.empty()) { // single digit
+    return 11;
+  }
+  const auto block = blocks[static_cast<std::size_t>(
+      rng.uniform(0, static_cast<int64_t>(blocks.size()) - 1))];
+  auto prefix = std::stoull(digits.substr(0, block));
+  for (;; ++prefix) {
+    std::string repeated;
+    for (auto i = 0uz; i < digits.size() / block; ++i) {
+      repeated += std::to_string(prefix);
+    }
+    if (repeated.size() == digits.size() && std::stoull(repeated) >= n) {
+      return std::stoull(repeated);
+    }
+    if (repeated.size() > digits.size()) {
+      return next_repeated(std::stoull("1" + std::string(digits.size(), '0')),
+                           rng);
+    }
+  }
+}
+
+// One line of increasing "lo-hi" ranges, comma separated. The ids grow
+// geometrically from 1 to 18 digits along the line and half of the ranges
+// are placed around a nearby number made of a repeated block, so that every
+// digit count and every block length gets its share of invalid ids.
+// The ranges are disjoint for even seeds. For odd seeds, one range in
+// OVERLAP_ODDS is followed by one that starts inside it, so that the ids
+// they share have to be counted once in part 2.
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  rng_t rng(seed);
+  const auto n_ranges = std::max(size / RANGE_BYTES, uint64_t{1});
+  const double growth =
+      std::exp(std::log(static_cast<double>(MAX_ID)) /
+               static_cast<double>(n_ranges)) - 1;
+  uint64_t cursor{1};
+  for (auto i = 0uz; out.size() < size && cursor < MAX_ID; ++i) {
+    // how far the next range may start, twice the mean gap
+    const auto reach = static_cast<uint64_t>(
+        std::min(static_cast<double>(cursor) * growth * 2 + 2 * MAX_MARGIN,
+                 static_cast<double>(MAX_ID)));
+    auto lo = cursor + static_cast<uint64_t>(rng.uniform(0, MAX_MARGIN));
+    auto hi = lo + static_cast<uint64_t>(rng.uniform(0, 2 * MAX_MARGIN));
+    if (rng.chance(1, 2)) {
+      const auto target = next_repeated(cursor, rng);
+      if (target - cursor <= reach) {
+        const auto margin = static_cast<uint64_t>(rng.uniform(0, MAX_MARGIN));
+        lo = target - std::min(target - cursor, margin);
+        hi = target + static_cast<uint64_t>(rng.uniform(0, MAX_MARGIN));
+      }
+    }
+    hi = std::min(hi, MAX_ID);
+    out << (i == 0 ? "" : ",") << static_cast<int64_t>(lo) << '-'
+        << static_cast<int64_t>(hi);
+    if (seed % 2 == 1 && rng.chance(1, OVERLAP_ODDS)) {
+      lo += static_cast<uint64_t>(
+          rng.uniform(0, static_cast<int64_t>(hi - lo)));
+      hi = std::min(hi + static_cast<uint64_t>(rng.uniform(0, MAX_MARGIN)),
+                    MAX_ID);
+      out << ',' << static_cast<int64_t>(lo) << '-' << static_cast<int64_t>(hi);
+    }
+    cursor = hi + 1 +
+             static_cast<uint64_t>(rng.uniform(
+                 0, static_cast<int64_t>(reach / 2 - MAX_MARGIN)));
+  }
+  out << '\n';
+}
+
+// Check every id of every range: an id is invalid for part 1 when it is a
+// block repeated twice and for part 2 when it is a block repeated at least
+// twice. Ids counted by part 2 are deduplicated across ranges.
+static void reference(std::string_view input) {
+  unsigned __int128 result_1{0};
+  std::vector<uint64_t> invalid_2;
+  std::string_view text = input;
+  for (uint64_t lo{0}, hi{0}; read_int(text, lo) && read_int(text, hi);) {
+    for (auto id = lo; id <= hi; ++id) {
+      const auto digits = std::to_string(id);
+      const auto n = digits.size();
+      for (auto block = 1uz; block <= n / 2; ++block) {
+        if (n % block != 0) {
+          continue;
+        }
+        bool repeated = true;
+        for (auto i = block; i < n && repeated; ++i) {
+          repeated = digits[i] == digits[i - block];
+        }
+        if (repeated) {
+          invalid_2.push_back(id);
+          break;
+        }
+      }
+      if (n % 2 == 0 && digits.substr(0, n / 2) == digits.substr(n / 2)) {
+        result_1 += id;
+      }
+    }
+  }
+  std::ranges::sort(invalid_2);
+  const auto [first, last] = std::ranges::unique(invalid_2);
+  invalid_2.erase(first, last);
+  unsigned __int128 result_2{0};
+  for (const auto id : invalid_2) {
+    result_2 += id;
+  }
+  std::println("Solution part 1: {}", to_string_128(result_1));
+  std::println("Solution part 2: {}", to_string_128(result_2));
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
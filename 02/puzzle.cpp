@@ -1,154 +1,232 @@
 #include <algorithm>
 #include <cassert>
-#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
-#include <iterator>
-#include <locale>
+#include <limits>
 #include <numeric>
 #include <ostream>
 #include <print>
 #include <ranges>
-#include <sstream>
+#include <span>
 #include <string>
 #include <utility>
 #include <vector>
 
-// input reading taken from:
-// https://marcoarena.wordpress.com/2016/03/13/cpp-competitive-programming-io/
-struct custom_delims : std::ctype<char> {
-  custom_delims() : ctype<char>(make_table()) {}
+#include "bench.h"
+#include "fast_input.h"
+#include "parallel.h"
 
-  static const mask *make_table() {
-    static mask table[ctype<char>::table_size];
-    table[' '] = table[','] = table['-'] = ctype_base::space;
-    return &table[0];
-  }
-};
+using product_id_t = uint64_t;
+using range_t = std::pair<product_id_t, product_id_t>;
+using sum_t = unsigned __int128;
 
-using range_t = std::pair<std::string, std::string>;
+// Largest number of digits handled, 10^MAX_DIGITS still fits in product_id_t
+const unsigned MAX_DIGITS = 19;
 
-std::string ten_to_the_power_of(std::size_t digits) {
-  std::string v(digits + 1, '0');
-  v[0] = '1';
+constexpr product_id_t ten_to_the_power_of(unsigned exponent) {
+  product_id_t v{1};
+  while (exponent-- > 0) {
+    v *= 10;
+  }
   return v;
 }
 
-std::string nines(std::size_t digits) {
-  std::string v(digits, '9');
-  return v;
+constexpr unsigned digits(product_id_t id) {
+  unsigned n{1};
+  while (id >= 10) {
+    id /= 10;
+    ++n;
+  }
+  return n;
 }
 
-void collect_invalid_ids_1(range_t range, std::vector<int64_t> &invalid) {
-  // NOTE: A repeated sequence appears only in even-sized strings
-  // 1. Normalise left and right, to be of even size, increment up to right
-  // bound
-  auto& [fst, snd] = range;
-  const auto fst_even = fst.size() % 2 == 0;
-  const auto snd_even = snd.size() % 2 == 0;
-  if (!fst_even) {
-    // round_up(fst);
-    fst = ten_to_the_power_of(fst.size());
-    if (fst >= snd) { // TODO: e se di lunghezza diversa? che succede?
-      return;
+// Möbius function, only ever called with n <= MAX_DIGITS
+constexpr int mobius(unsigned n) {
+  int result{1};
+  for (unsigned p = 2; p * p <= n; ++p) {
+    if (n % p == 0) {
+      n /= p;
+      if (n % p == 0) {
+        return 0;
+      }
+      result = -result;
     }
   }
-  if (!snd_even) {
-    // round_down(snd);
-    snd = nines(snd.size() - 1);
-    if (snd <= fst) {
-      return;
-    }
+  return n > 1 ? -result : result;
+}
+
+// Sum of the ids in [lo, hi], all of `length` digits, made of a block of
+// `block` digits repeated length / block times.
+// Such an id is b * multiplier, with multiplier = 1 0..0 1 0..0 ... 1 and b
+// any number of exactly `block` digits, so the ids in the range are an
+// arithmetic series over the block values b in [ceil(lo / m), floor(hi / m)].
+sum_t repeated_blocks_sum(product_id_t lo, product_id_t hi, unsigned length, unsigned block) {
+  assert(length % block == 0);
+  product_id_t multiplier{0};
+  for (auto rep = 0u; rep < length / block; ++rep) {
+    multiplier = multiplier * ten_to_the_power_of(block) + 1;
   }
-  const auto snd_n = std::stoul(snd);
-  const auto fst_n = std::stoul(fst);
-  auto current = fst;
-  auto current_n = fst_n;
-  while (current_n <= snd_n) {
-    const auto mid = current.size() / 2;
-    std::copy_n(current.begin(), mid, std::next(current.begin(), mid));
-    current_n = std::stoul(current);
-    if (current_n >= fst_n && current_n <= snd_n) {
-      invalid.push_back(current_n);
-      // std::cout << current << std::endl;
-    }
-    // increment current
-    current_n += std::pow(10, mid);
-    current = std::to_string(current_n);
-    // TODO: check if multiple of 2
+  const auto b_lo =
+      std::max(ten_to_the_power_of(block - 1), (lo + multiplier - 1) / multiplier);
+  const auto b_hi = std::min(ten_to_the_power_of(block) - 1, hi / multiplier);
+  if (b_lo > b_hi) {
+    return 0;
   }
+  const sum_t n_blocks = b_hi - b_lo + 1;
+  const sum_t blocks_sum = (sum_t{b_lo} + b_hi) * n_blocks / 2;
+  return blocks_sum * multiplier;
 }
 
-void collect_invalid_ids_2(const range_t& range, const std::size_t repetitions,
-                           std::vector<int64_t> &invalid_ids) {
-  auto& [fst, snd] = range;
-  const auto fst_n = std::stoul(fst);
-  const auto snd_n = std::stoul(snd);
-  auto current = fst;
-  auto current_n = fst_n;
-  do {
-    const auto rem = current.size() % repetitions;
-    if (rem != 0) {
-      current = ten_to_the_power_of(current.size() + repetitions - rem - 1);
-      assert(current.size() % repetitions == 0);
-    }
-    const auto window_size = current.size() / repetitions;
-    const auto begin = current.begin();
-    auto dest = begin;
-    for (int j = 1; j < repetitions; ++j) {
-      std::advance(dest, window_size);
-      std::copy_n(begin, window_size, dest);
-    }
-    current_n = std::stoul(current);
-    if (current_n >= fst_n && current_n <= snd_n) {
-      invalid_ids.push_back(current_n);
+// Call f(lo, hi, length) for the sub-ranges of range whose ids have the same
+// number of digits.
+template <class F> sum_t for_each_length(range_t range, F f) {
+  auto [fst, snd] = range;
+  assert(digits(snd) <= MAX_DIGITS);
+  sum_t result{0};
+  for (auto length = digits(fst); length <= digits(snd); ++length) {
+    const auto lo = std::max(fst, ten_to_the_power_of(length - 1));
+    const auto hi = std::min(snd, ten_to_the_power_of(length) - 1);
+    result += f(lo, hi, length);
+  }
+  return result;
+}
+
+// Sum of the ids in range made of some digits repeated twice
+sum_t sum_invalid_ids_1(range_t range) {
+  // NOTE: A repeated sequence appears only in even-sized strings
+  return for_each_length(range, [](product_id_t lo, product_id_t hi, unsigned length) {
+    return length % 2 == 0 ? repeated_blocks_sum(lo, hi, length, length / 2)
+                           : sum_t{0};
+  });
+}
+
+// Sum of the ids in range made of some digits repeated at least twice.
+// An id whose shortest repeating block has p digits is also made of blocks of
+// every multiple of p dividing the length, e.g. 111111 has blocks of 1, 2 and
+// 3 digits. Inclusion-exclusion over the divisors of the length, weighted by
+// the Möbius function, counts each of them exactly once.
+sum_t sum_invalid_ids_2(range_t range) {
+  return for_each_length(range, [](product_id_t lo, product_id_t hi, unsigned length) {
+    sum_t added{0};
+    sum_t removed{0};
+    for (auto block = 1u; block < length; ++block) {
+      if (length % block != 0) {
+        continue;
+      }
+      const auto weight = -mobius(length / block);
+      if (weight > 0) {
+        added += repeated_blocks_sum(lo, hi, length, block);
+      } else if (weight < 0) {
+        removed += repeated_blocks_sum(lo, hi, length, block);
+      }
     }
-    current_n += std::pow(10, window_size * (repetitions - 1));
-    current = std::to_string(current_n);
-  } while (current_n <= snd_n);
+    return added - removed;
+  });
 }
 
-int main() {
-  // std::println("Ciao, {}!", "Mondo");
-  std::string line;
-  std::getline(std::cin, line);
-  std::istringstream ss{std::move(line)};
-  ss.imbue(std::locale(std::cin.getloc(), new custom_delims()));
-
-  std::vector<std::string> v{};
-  std::copy(std::istream_iterator<std::string>(ss),
-            std::istream_iterator<std::string>(), std::back_inserter(v));
-
-  std::vector<range_t> ranges;
-  for (auto first = v.begin(); first != v.end(); ++first) {
-    auto second = std::next(first);
-    if (second == v.end())
-      break;
-    ranges.emplace_back(std::move(*first), std::move(*second));
-    first = second;
+// Sort the ranges and merge the overlapping ones, so that an id appearing in
+// more than one range is summed once
+void merge_ranges(std::vector<range_t> &ranges) {
+  if (ranges.empty()) {
+    return;
   }
-  // Part 1
-  std::vector<int64_t> invalid_ids;
-  for (auto &s : ranges) {
-    collect_invalid_ids_1(s, invalid_ids);
-    // check_invalid_rep(s, 2, invalid_ids);
+  std::ranges::sort(ranges);
+  auto write_it = ranges.begin();
+  for (auto it = std::next(write_it); it != ranges.end(); ++it) {
+    if (write_it->second < it->first) {
+      *++write_it = *it;
+    } else {
+      write_it->second = std::max(write_it->second, it->second);
+    }
   }
-  std::cout << "Solution part 1: "
-            << std::ranges::fold_left(invalid_ids, 0u, std::plus<>())
-            << std::endl;
-  invalid_ids.clear();
-  // Part 2
-  for (auto &s : ranges) {
-    for (int rep = 2; rep <= s.second.size(); ++rep) {
-      collect_invalid_ids_2(s, rep, invalid_ids);
+  ranges.erase(std::next(write_it), ranges.end());
+}
+
+// Same as parallel_for, summing the partial results of the tasks
+template <class T, class F> T parallel_reduce(std::size_t n_tasks, F task) {
+  std::vector<T> partials(n_tasks);
+  parallel_for(n_tasks, [&partials, &task](std::size_t i) { partials[i] = task(i); });
+  return std::ranges::fold_left(partials, T{}, std::plus<>());
+}
+
+// Call f(range) for every "lo-hi" range in chunk
+template <class F> void for_each_range(std::string_view chunk, F f) {
+  range_t range;
+  while (read_int(chunk, range.first) && read_int(chunk, range.second)) {
+    f(range);
+  }
+}
+
+struct chunk_sums {
+  sum_t part_1{0};
+  sum_t part_2{0};
+  // smallest interval containing every range of the chunk
+  range_t hull{std::numeric_limits<product_id_t>::max(), 0};
+  // ranges are listed in increasing order and do not overlap
+  bool disjoint{true};
+};
+
+// Solve both parts, parsing the ranges in place on every core.
+// Part 2 has to sum every id once, which the per-range sums do only as long as
+// the ranges are disjoint: that is checked on the fly, and if it does not hold
+// the ranges are collected and merged before summing part 2 again.
+std::pair<sum_t, sum_t> solve(std::string_view input) {
+  const auto chunks =
+      split_chunks(input, n_workers(input.size(), 1uz << 20), ',');
+  std::vector<chunk_sums> partials(chunks.size());
+  parallel_for(chunks.size(), [&chunks, &partials](std::size_t i) {
+    auto &sums = partials[i];
+    for_each_range(chunks[i], [&sums](range_t range) {
+      sums.part_1 += sum_invalid_ids_1(range);
+      sums.part_2 += sum_invalid_ids_2(range);
+      sums.disjoint = sums.disjoint && (sums.hull.second < range.first ||
+                                        sums.hull.first > sums.hull.second);
+      sums.hull = {std::min(sums.hull.first, range.first),
+                   std::max(sums.hull.second, range.second)};
+    });
+  });
+
+  sum_t part_1{0};
+  sum_t part_2{0};
+  bool disjoint{true};
+  product_id_t last_id{0};
+  for (auto &sums : partials) {
+    part_1 += sums.part_1;
+    part_2 += sums.part_2;
+    if (sums.hull.first <= sums.hull.second) { // chunk is not empty
+      disjoint = disjoint && sums.disjoint &&
+                 (last_id == 0 || last_id < sums.hull.first);
+      last_id = sums.hull.second;
     }
   }
-  std::sort(invalid_ids.begin(), invalid_ids.end());
-  auto last = std::unique(invalid_ids.begin(), invalid_ids.end());
-  invalid_ids.erase(last, invalid_ids.end());
-  std::cout << "Solution part 2: "
-            << std::ranges::fold_left(invalid_ids, 0, std::plus<>())
-            << std::endl;
+  if (!disjoint) {
+    std::vector<range_t> ranges;
+    for_each_range(input, [&ranges](range_t range) { ranges.push_back(range); });
+    merge_ranges(ranges);
+    const auto n_tasks = n_workers(ranges.size(), 1uz << 16);
+    part_2 = parallel_reduce<sum_t>(n_tasks, [&ranges, n_tasks](std::size_t i) {
+      const auto ranges_span = std::span(ranges);
+      const auto first = ranges.size() * i / n_tasks;
+      const auto last = ranges.size() * (i + 1) / n_tasks;
+      sum_t result{0};
+      for (auto range : ranges_span.subspan(first, last - first)) {
+        result += sum_invalid_ids_2(range);
+      }
+      return result;
+    });
+  }
+  return {part_1, part_2};
+}
+
+int main() {
+  // std::println("Ciao, {}!", "Mondo");
+  phase_timer timer;
+  input_buffer input;
+  timer.lap("map");
+  const auto [result_1, result_2] = solve(input.view());
+  timer.lap("solve");
+  std::cout << "Solution part 1: " << to_string_128(result_1) << std::endl;
+  std::cout << "Solution part 2: " << to_string_128(result_2) << std::endl;
 }
@@ -0,0 +1,53 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <cstdint>
+#include <print>
+#include <string_view>
+
+#include "generator.h"
+
+const int64_t BANK_SIZE = 100;
+
+// One bank of BANK_SIZE batteries per line, joltages 1 to 9
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  rng_t rng(seed);
+  while (out.size() < size) {
+    for (auto i = 0; i < BANK_SIZE; ++i) {
+      out << static_cast<char>('0' + rng.uniform(1, 9));
+    }
+    out << '\n';
+  }
+}
+
+// Greedy choice, one digit at a time: the leftmost largest digit that still
+// leaves enough batteries after it for the digits to come
+static unsigned __int128 max_joltage(std::string_view bank, std::size_t k) {
+  unsigned __int128 joltage{0};
+  auto from = bank.begin();
+  for (auto left = k; left > 0; --left) {
+    const auto choice = std::max_element(
+        from, bank.end() - static_cast<std::ptrdiff_t>(left - 1),
+        [](char a, char b) { return a < b; });
+    joltage = joltage * 10 + static_cast<unsigned>(*choice - '0');
+    from = choice + 1;
+  }
+  return joltage;
+}
+
+static void reference(std::string_view input) {
+  unsigned __int128 result_1{0};
+  unsigned __int128 result_2{0};
+  for (auto line : lines(input)) {
+    if (line.size() < 12) {
+      continue;
+    }
+    result_1 += max_joltage(line, 2);
+    result_2 += max_joltage(line, 12);
+  }
+  std::println("Solution part 1: {}", to_string_128(result_1));
+  std::println("Solution part 2: {}", to_string_128(result_2));
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
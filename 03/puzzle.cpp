@@ -1,62 +1,86 @@
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
-#include <iostream>
-#include <iterator>
 #include <print>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-int main() {
-  std::println("Ciao, {}!", "Mondo");
-  std::string line;
-  int64_t result_1{0};
-  int64_t result_2{0};
+#include "bench.h"
+#include "fast_input.h"
+#include "parallel.h"
 
-  while (std::getline(std::cin, line)) {
-    // PART 1
-    auto decimal = line.cbegin();
-    auto unit = std::next(decimal);
-    for (auto fst = decimal, snd = unit; fst != std::prev(line.end());
-         ++fst, ++snd) {
-      if (*fst > *decimal) {
-        decimal = fst;
-        unit = snd;
-      } else if (*snd > *unit) {
-        unit = snd;
-      }
+// Largest number made of K digits of bank, taken in order.
+// Single pass with a monotonic stack: a digit replaces the smaller digits
+// before it as long as enough digits are left to fill the remaining K slots.
+template <std::size_t K> int64_t select_max_subsequence(std::string_view bank) {
+  static_assert(K > 0 && K <= 18, "result must fit in an int64_t");
+  assert(bank.size() >= K);
+  std::array<char, K> stack{};
+  std::size_t top{0};
+  auto batteries_left = bank.size();
+  for (const char battery : bank) {
+    while (top > 0 && stack[top - 1] < battery && top + batteries_left > K) {
+      --top;
     }
-    result_1 += std::stoi(std::string{*decimal, *unit});
+    if (top < K) {
+      stack[top++] = battery;
+    }
+    --batteries_left;
+  }
+  int64_t joltage{0};
+  for (const char battery : stack) {
+    joltage = joltage * 10 + (battery - '0');
+  }
+  return joltage;
+}
 
-    // PART 2
-    const std::size_t n_batteries{12};
-    std::string s_batteries(n_batteries, '0');
-    std::vector<std::string::const_iterator> v_batteries(
-        n_batteries); // vector of iterators to positions in line
-    auto beg = line.cbegin();
-    std::generate_n(v_batteries.begin(), n_batteries,
-                    [&beg]() { return beg++; });
-    auto batteries_left = line.size();
-    for (auto current = line.cbegin(); current != line.cend();
-         ++current, --batteries_left) {
-      auto assignable_batteries = std::min(n_batteries, batteries_left);
-      auto batteries_begin = std::prev(v_batteries.end(), assignable_batteries);
-      auto battery_it = std::find_if(
-          batteries_begin, v_batteries.end(),
-          [&current](const auto &battery_it) {
-            return current > battery_it && // current is past stored iterator
-                   *current > *battery_it;
-          });
-      auto new_it = current;
-      std::generate(battery_it, v_batteries.end(),
-                    [&new_it]() { return new_it++; });
+using results_t = std::pair<int64_t, int64_t>;
+
+// Solve both parts for the banks in chunk, one per line, without allocating
+results_t solve_banks(std::string_view chunk) {
+  results_t results{0, 0};
+  for (auto line : lines(chunk)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      continue;
     }
-    std::transform(v_batteries.cbegin(), v_batteries.cend(),
-                   s_batteries.begin(), [](auto &it) { return *it; });
-    result_2 += std::stoll(s_batteries);
+    results.first += select_max_subsequence<2>(line);
+    results.second += select_max_subsequence<12>(line);
   }
+  return results;
+}
+
+// Split the banks in one chunk per core, cutting at line boundaries, and solve
+// the chunks concurrently
+results_t solve_banks_parallel(std::string_view input) {
+  const auto chunks =
+      split_chunks(input, n_workers(input.size(), 1uz << 20), '\n');
+  std::vector<results_t> partials(chunks.size(), {0, 0});
+  parallel_for(chunks.size(), [&partials, &chunks](std::size_t i) {
+    partials[i] = solve_banks(chunks[i]);
+  });
+  results_t results{0, 0};
+  for (auto [result_1, result_2] : partials) {
+    results.first += result_1;
+    results.second += result_2;
+  }
+  return results;
+}
+
+int main() {
+  std::println("Ciao, {}!", "Mondo");
+  phase_timer timer;
+  input_buffer input;
+  timer.lap("map");
+  const auto [result_1, result_2] = solve_banks_parallel(input.view());
+  timer.lap("solve");
 
   std::println("Solution part 1: {}", result_1);
   std::println("Solution part 2: {}", result_2);
@@ -0,0 +1,80 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+const char ROLL_C = '@';
+const char EMPTY_C = '.';
+
+// A square grid, about two thirds of the cells holding a roll
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  rng_t rng(seed);
+  const auto side = std::max<uint64_t>(
+      3, static_cast<uint64_t>(std::sqrt(static_cast<double>(size))));
+  std::string row(side, EMPTY_C);
+  for (auto i = 0uz; i < side; ++i) {
+    for (auto &cell : row) {
+      cell = rng.chance(2, 3) ? ROLL_C : EMPTY_C;
+    }
+    out << std::string_view(row) << '\n';
+  }
+}
+
+// Count neighbours cell by cell, removing the accessible rolls in rounds
+// until none is left. The grid gets a border of empty cells, so that every
+// cell has eight neighbours.
+static void reference(std::string_view input) {
+  std::vector<std::string> grid(1);
+  for (auto line : lines(input)) {
+    if (!line.empty()) {
+      grid.push_back(EMPTY_C + std::string(line) + EMPTY_C);
+    }
+  }
+  const auto columns = grid.size() > 1 ? grid[1].size() : 0;
+  grid.front() = std::string(columns, EMPTY_C);
+  grid.emplace_back(columns, EMPTY_C);
+  auto accessible = [&grid](std::size_t row, std::size_t col) {
+    int neighbours{0};
+    for (auto i = row - 1; i <= row + 1; ++i) {
+      for (auto j = col - 1; j <= col + 1; ++j) {
+        neighbours += grid[i][j] == ROLL_C;
+      }
+    }
+    return neighbours - 1 < 4; // the roll itself is not a neighbour
+  };
+
+  int64_t result_1{-1};
+  int64_t result_2{0};
+  for (int64_t removed{1}; removed > 0;) {
+    std::vector<std::pair<std::size_t, std::size_t>> to_remove;
+    for (auto row = 1uz; row + 1 < grid.size(); ++row) {
+      for (auto col = 1uz; col + 1 < columns; ++col) {
+        if (grid[row][col] == ROLL_C && accessible(row, col)) {
+          to_remove.emplace_back(row, col);
+        }
+      }
+    }
+    for (auto [row, col] : to_remove) {
+      grid[row][col] = EMPTY_C;
+    }
+    removed = std::ssize(to_remove);
+    if (result_1 < 0) {
+      result_1 = removed;
+    }
+    result_2 += removed;
+  }
+  std::println("Solution part 1: {}", result_1);
+  std::println("Solution part 2: {}", result_2);
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
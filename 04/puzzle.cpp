@@ -1,19 +1,27 @@
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
-#include <iostream>
-#include <iterator>
+#include <filesystem>
+#include <functional>
 #include <mdspan>
 #include <ostream>
 #include <print>
 #include <span>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <valarray>
 #include <vector>
 
+#include "bench.h"
+#include "fast_input.h"
+#include "parallel.h"
+
 const char ROLL_C = '@';
 const char EMPTY_C = '.';
 
@@ -61,47 +69,430 @@ int64_t eligible_rolls_1(cgrid_t &grid) {
 }
 
 
+// bit grid: one bit per cell, set when the cell holds a roll.
+// Every row is padded with an empty word on both sides and the grid with an
+// empty row above and below, so that the neighbours of border cells can be
+// read without bounds checks.
+class bgrid_t {
+public:
+  using word_t = uint64_t;
+  static constexpr std::size_t WORD_BITS = 64;
+
+  explicit bgrid_t(const cgrid_t &grid)
+      : _rows(grid.extent(0)), _columns(grid.extent(1)),
+        _words((_columns + WORD_BITS - 1) / WORD_BITS),
+        _bits((_rows + 2) * (_words + 2), 0) {
+    for (auto row = 0uz; row < _rows; ++row) {
+      auto bits = this->row(row);
+      for (auto col = 0uz; col < _columns; ++col) {
+        if (grid[row, col] == ROLL_C) {
+          bits[col / WORD_BITS] |= word_t{1} << (col % WORD_BITS);
+        }
+      }
+    }
+  }
+
+  std::size_t rows() const { return _rows; }
+  std::size_t words() const { return _words; }
+
+  // Words of a row, indices -1 and words() are the padding
+  word_t *row(std::size_t row) {
+    return &_bits[(row + 1) * (_words + 2) + 1];
+  }
+  const word_t *row(std::size_t row) const {
+    return &_bits[(row + 1) * (_words + 2) + 1];
+  }
+  // Empty row, used as a neighbour of the first and last rows
+  const word_t *padding_row() const { return &_bits[1]; }
+
+private:
+  std::size_t _rows;
+  std::size_t _columns;
+  std::size_t _words;
+  std::vector<word_t> _bits;
+};
+
+// Rolls, among the 64 cells of word w of row mid, with less than 4 rolls in
+// their 8 neighbours.
+// The neighbours of the 64 cells are 8 bit planes, obtained by shifting the
+// rows above, below and the row itself by one column. The planes are summed
+// bit-sliced with carry-save adders: a full adder turns three planes of the
+// same weight into a sum plane and a carry plane of twice that weight. Only
+// the planes of weight 4 and above are needed to tell whether a count is
+// below 4.
+inline bgrid_t::word_t eligible_rolls_mask(const bgrid_t::word_t *up,
+                                           const bgrid_t::word_t *mid,
+                                           const bgrid_t::word_t *down,
+                                           std::ptrdiff_t w) {
+  using word_t = bgrid_t::word_t;
+  const auto last = bgrid_t::WORD_BITS - 1;
+  auto left = [w, last](const word_t *r) { // neighbour at column - 1
+    return (r[w] << 1) | (r[w - 1] >> last);
+  };
+  auto right = [w, last](const word_t *r) { // neighbour at column + 1
+    return (r[w] >> 1) | (r[w + 1] << last);
+  };
+  auto full_adder = [](word_t a, word_t b, word_t c) {
+    return std::pair{a ^ b ^ c, (a & b) | (c & (a ^ b))};
+  };
+  const auto [ones_a, twos_a] = full_adder(left(up), up[w], right(up));
+  const auto [ones_b, twos_b] = full_adder(left(down), down[w], right(down));
+  const word_t l = left(mid), r = right(mid);
+  const auto [ones_c, twos_c] = std::pair{l ^ r, l & r};
+  const auto twos_d = full_adder(ones_a, ones_b, ones_c).second;
+  const auto [twos, fours_a] = full_adder(twos_a, twos_b, twos_c);
+  const auto fours_b = twos & twos_d;
+  return mid[w] & ~(fours_a | fours_b);
+}
+
+int64_t eligible_rolls_1(const bgrid_t &grid) {
+  int64_t result{0};
+  const auto rows = grid.rows();
+  const auto words = static_cast<std::ptrdiff_t>(grid.words());
+  for (auto row = 0uz; row < rows; ++row) {
+    const auto up = row == 0 ? grid.padding_row() : grid.row(row - 1);
+    const auto down = row + 1 == rows ? grid.padding_row() : grid.row(row + 1);
+    const auto mid = grid.row(row);
+    for (std::ptrdiff_t w = 0; w < words; ++w) {
+      result += std::popcount(eligible_rolls_mask(up, mid, down, w));
+    }
+  }
+  return result;
+}
+
+// Remove eligible rolls until none is left, peeling them k-core style:
+// neighbour counts are computed once, then every removal decrements the
+// counts of its 8 neighbours and queues those that just became eligible.
+// Rolls are removed in a different order than round by round, but the rolls
+// that are never removed are the same, hence so is the total.
 int64_t eligible_rolls_2(cgrid_t &grid) {
   const auto rows{grid.extent(0)};
   const auto columns{grid.extent(1)};
+  // counts are padded with an empty border, so neighbours are plain offsets
+  const auto stride = columns + 2;
+  const uint8_t EMPTY{0xFF};
+  const uint8_t MAX_ADJACENT_ROLLS{3};
+  std::vector<uint8_t> counts((rows + 2) * stride, EMPTY);
+  const std::array<std::ptrdiff_t, 8> neighbours{
+      -static_cast<std::ptrdiff_t>(stride) - 1,
+      -static_cast<std::ptrdiff_t>(stride),
+      -static_cast<std::ptrdiff_t>(stride) + 1,
+      -1,
+      1,
+      static_cast<std::ptrdiff_t>(stride) - 1,
+      static_cast<std::ptrdiff_t>(stride),
+      static_cast<std::ptrdiff_t>(stride) + 1};
+
+  std::vector<std::size_t> eligible;
+  for (auto row = 0uz; row < rows; ++row) {
+    for (auto col = 0uz; col < columns; ++col) {
+      if (grid[row, col] == ROLL_C) {
+        counts[(row + 1) * stride + col + 1] = 0;
+      }
+    }
+  }
+  for (auto cell = stride; cell < (rows + 1) * stride; ++cell) {
+    if (counts[cell] == EMPTY) {
+      continue;
+    }
+    for (auto offset : neighbours) {
+      counts[cell] += counts[cell + offset] != EMPTY;
+    }
+    if (counts[cell] <= MAX_ADJACENT_ROLLS) {
+      eligible.push_back(cell);
+    }
+  }
+
   int64_t result{0};
+  while (!eligible.empty()) {
+    const auto cell = eligible.back();
+    eligible.pop_back();
+    counts[cell] = EMPTY;
+    grid[cell / stride - 1, cell % stride - 1] = EMPTY_C;
+    ++result;
+    for (auto offset : neighbours) {
+      auto &count = counts[cell + offset];
+      if (count != EMPTY && count-- == MAX_ADJACENT_ROLLS + 1) {
+        eligible.push_back(cell + offset);
+      }
+    }
+  }
+  return result;
+}
 
-  std::vector<std::array<int64_t, 2>> eligible;
-  do {
-    eligible.clear();
-    for (auto row = 0; row < rows; ++row) {
-      for (auto col = 0; col < columns; ++col) {
-        int64_t adjacenct_rolls{};
-        if (grid[row, col] == ROLL_C) {
-          for (auto [h, k] : indeces(rows, columns, row, col)) {
-            adjacenct_rolls += grid[h, k] == ROLL_C;
+// Writable memory backed by an unlinked temporary file instead of swap, so the
+// OS can write it back and evict it when it does not fit in memory.
+template <class T> class scratch_buffer {
+public:
+  explicit scratch_buffer(std::size_t size) : _size(size) {
+    auto path =
+        (std::filesystem::temp_directory_path() / "rollsXXXXXX").string();
+    const int fd = mkstemp(path.data());
+    if (fd < 0) {
+      throw std::filesystem::filesystem_error(
+          "mkstemp", path, std::error_code(errno, std::generic_category()));
+    }
+    unlink(path.c_str());
+    const auto bytes = static_cast<off_t>(size * sizeof(T));
+    void *addr = ftruncate(fd, bytes) == 0
+                     ? mmap(nullptr, size * sizeof(T), PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, 0)
+                     : MAP_FAILED;
+    close(fd);
+    if (addr == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    _data = static_cast<T *>(addr);
+  }
+  scratch_buffer(const scratch_buffer &) = delete;
+  scratch_buffer &operator=(const scratch_buffer &) = delete;
+  ~scratch_buffer() { munmap(_data, _size * sizeof(T)); }
+
+  T *data() { return _data; }
+  const T *data() const { return _data; }
+
+private:
+  T *_data;
+  std::size_t _size;
+};
+
+// Tiled engine for grids that do not fit in memory as chars.
+// The mapped input is packed in a bit grid, with the same padded layout as
+// bgrid_t, stored in a scratch file. The bit grid is cut in tiles of
+// TILE_ROWS x TILE_WORDS words that fit in cache and are solved on all cores,
+// each with a halo of one row above and below and one word on each side.
+class tiled_grid_t {
+public:
+  using word_t = bgrid_t::word_t;
+  static constexpr std::size_t WORD_BITS = bgrid_t::WORD_BITS;
+  static constexpr std::size_t TILE_ROWS = 256;
+  static constexpr std::size_t TILE_WORDS = 32;
+
+  // input is a grid of rows of the same width, each ended by a newline
+  explicit tiled_grid_t(std::string_view input)
+      : _columns(std::min(input.find('\n'), input.size())),
+        _rows((input.size() + 1) / (_columns + 1)),
+        _words((_columns + WORD_BITS - 1) / WORD_BITS),
+        _bits((_rows + 2) * stride()) {
+    std::fill_n(row(-1) - 1, stride(), word_t{0});
+    std::fill_n(row(static_cast<std::ptrdiff_t>(_rows)) - 1, stride(),
+                word_t{0});
+    const auto n_tasks = n_workers();
+    parallel_for(n_tasks, [this, input, n_tasks](std::size_t task) {
+      const auto last_row = _rows * (task + 1) / n_tasks;
+      for (auto r = _rows * task / n_tasks; r < last_row; ++r) {
+        const auto line = input.substr(r * (_columns + 1), _columns);
+        auto bits = row(static_cast<std::ptrdiff_t>(r));
+        bits[-1] = bits[_words] = 0;
+        for (auto w = 0uz; w < _words; ++w) {
+          const auto chars = line.substr(w * WORD_BITS, WORD_BITS);
+          word_t word{0};
+          for (auto bit = 0uz; bit < chars.size(); ++bit) {
+            word |= word_t{chars[bit] == ROLL_C} << bit;
+          }
+          bits[w] = word;
+        }
+      }
+    });
+  }
+
+  // Rolls with less than 4 neighbouring rolls
+  int64_t eligible_rolls_1() const {
+    const auto n_tasks = n_workers();
+    std::vector<int64_t> partials(n_tasks, 0);
+    parallel_for(n_tasks, [this, &partials, n_tasks](std::size_t task) {
+      const auto words = static_cast<std::ptrdiff_t>(_words);
+      const auto last_row =
+          static_cast<std::ptrdiff_t>(_rows * (task + 1) / n_tasks);
+      for (auto r = static_cast<std::ptrdiff_t>(_rows * task / n_tasks);
+           r < last_row; ++r) {
+        for (std::ptrdiff_t w = 0; w < words; ++w) {
+          partials[task] += std::popcount(
+              eligible_rolls_mask(row(r - 1), row(r), row(r + 1), w));
+        }
+      }
+    });
+    return std::ranges::fold_left(partials, 0z, std::plus<>());
+  }
+
+  // Remove eligible rolls until none is left.
+  // Removing a roll can only make other rolls eligible, so any tile can be
+  // peeled on its own, against the current state of its halo, and the rolls
+  // removed are still the same. Tiles are peeled in four colours, like a
+  // checkerboard with 2x2 squares, so that no tile reads the halo of a tile
+  // being peeled at the same time. A tile whose border changed makes its
+  // neighbours dirty, and rounds go on until no tile is dirty.
+  int64_t eligible_rolls_2() {
+    const auto tile_rows = (_rows + TILE_ROWS - 1) / TILE_ROWS;
+    const auto tile_cols = (_words + TILE_WORDS - 1) / TILE_WORDS;
+    std::vector<std::atomic<bool>> dirty(tile_rows * tile_cols);
+    for (auto &d : dirty) {
+      d.store(true, std::memory_order_relaxed);
+    }
+    std::atomic<int64_t> result{0};
+    bool any_dirty{true};
+    while (any_dirty) {
+      any_dirty = false;
+      for (auto colour = 0uz; colour < 4; ++colour) {
+        std::vector<std::size_t> tiles;
+        for (auto tile = 0uz; tile < dirty.size(); ++tile) {
+          const auto colour_of_tile =
+              (tile / tile_cols) % 2 * 2 + (tile % tile_cols) % 2;
+          if (colour_of_tile == colour && dirty[tile].exchange(false)) {
+            tiles.push_back(tile);
+          }
+        }
+        any_dirty = any_dirty || !tiles.empty();
+        std::atomic<std::size_t> next_tile{0};
+        parallel_for(std::min(n_workers(), tiles.size()), [&](std::size_t) {
+          std::vector<word_t> buffer((TILE_ROWS + 2) * (TILE_WORDS + 2));
+          for (auto i = next_tile++; i < tiles.size(); i = next_tile++) {
+            const auto tile_row = tiles[i] / tile_cols;
+            const auto tile_col = tiles[i] % tile_cols;
+            const auto [removed, border_changed] =
+                peel_tile(tile_row, tile_col, buffer);
+            result += removed;
+            if (!border_changed) {
+              continue;
+            }
+            for (auto dr = -1; dr <= 1; ++dr) {
+              for (auto dc = -1; dc <= 1; ++dc) {
+                const auto nr = static_cast<std::ptrdiff_t>(tile_row) + dr;
+                const auto nc = static_cast<std::ptrdiff_t>(tile_col) + dc;
+                if ((dr != 0 || dc != 0) && nr >= 0 && nc >= 0 &&
+                    nr < static_cast<std::ptrdiff_t>(tile_rows) &&
+                    nc < static_cast<std::ptrdiff_t>(tile_cols)) {
+                  dirty[static_cast<std::size_t>(nr) * tile_cols +
+                        static_cast<std::size_t>(nc)] = true;
+                }
+              }
+            }
           }
-          if (adjacenct_rolls < 4) {
-            eligible.push_back({row, col});
+        });
+      }
+    }
+    return result;
+  }
+
+private:
+  std::size_t stride() const { return _words + 2; }
+
+  // Words of a row, rows -1 and rows() and words -1 and words() are the padding
+  word_t *row(std::ptrdiff_t r) {
+    return _bits.data() + (r + 1) * static_cast<std::ptrdiff_t>(stride()) + 1;
+  }
+  const word_t *row(std::ptrdiff_t r) const {
+    return _bits.data() + (r + 1) * static_cast<std::ptrdiff_t>(stride()) + 1;
+  }
+
+  // Peel a tile in buffer, together with its halo, until none of its rolls is
+  // eligible and write it back. Return the number of rolls removed and whether
+  // any of them was on the border of the tile.
+  std::pair<int64_t, bool> peel_tile(std::size_t tile_row,
+                                     std::size_t tile_col,
+                                     std::vector<word_t> &buffer) {
+    const auto first_row = static_cast<std::ptrdiff_t>(tile_row * TILE_ROWS);
+    const auto first_word = static_cast<std::ptrdiff_t>(tile_col * TILE_WORDS);
+    const auto rows = static_cast<std::ptrdiff_t>(
+        std::min(TILE_ROWS, _rows - tile_row * TILE_ROWS));
+    const auto words = static_cast<std::ptrdiff_t>(
+        std::min(TILE_WORDS, _words - tile_col * TILE_WORDS));
+    const auto local_stride = words + 2;
+    auto local_row = [&buffer, local_stride](std::ptrdiff_t r) {
+      return buffer.data() + (r + 1) * local_stride + 1;
+    };
+    for (auto r = -1z; r <= rows; ++r) {
+      std::copy_n(row(first_row + r) + first_word - 1, local_stride,
+                  local_row(r) - 1);
+    }
+
+    int64_t removed{0};
+    bool changed{true};
+    while (changed) {
+      changed = false;
+      for (auto r = 0z; r < rows; ++r) {
+        for (auto w = 0z; w < words; ++w) {
+          const auto eligible = eligible_rolls_mask(
+              local_row(r - 1), local_row(r), local_row(r + 1), w);
+          if (eligible != 0) {
+            local_row(r)[w] &= ~eligible;
+            removed += std::popcount(eligible);
+            changed = true;
           }
         }
       }
     }
-    result += eligible.size();
-    for (auto [row, col] : eligible){
-      grid[row,col] = EMPTY_C;
+
+    bool border_changed{false};
+    const word_t edge_bits = word_t{1} | word_t{1} << (WORD_BITS - 1);
+    for (auto r = 0z; r < rows; ++r) {
+      auto original = row(first_row + r) + first_word;
+      const auto peeled = local_row(r);
+      if (r == 0 || r == rows - 1) {
+        border_changed = border_changed ||
+                         !std::equal(original, original + words, peeled);
+      } else {
+        const auto first_diff = original[0] ^ peeled[0];
+        const auto last_diff = original[words - 1] ^ peeled[words - 1];
+        border_changed =
+            border_changed || ((first_diff | last_diff) & edge_bits) != 0;
+      }
+      std::copy_n(peeled, words, original);
     }
-  } while (!eligible.empty());
-  return result;
-}
+    return {removed, border_changed};
+  }
 
-int main() {
+  std::size_t _columns;
+  std::size_t _rows;
+  std::size_t _words;
+  scratch_buffer<word_t> _bits;
+};
+
+int main(int argc, char *argv[]) {
   std::println("Ciao, {}!", "Mondo");
+  const std::vector<std::string_view> options(argv + 1, argv + argc);
+  auto has_option = [&options](std::string_view option) {
+    return std::ranges::find(options, option) != options.end();
+  };
+  // --char-grid solves part 1 on the char grid instead of the bit grid
+  const bool char_grid = has_option("--char-grid");
+  phase_timer timer;
+  // --tiled solves both parts with the tiled engine, stdin must be a file
+  if (has_option("--tiled")) {
+    mapped_input input(STDIN_FILENO);
+    if (input.empty()) {
+      std::println(stderr, "--tiled needs a non-empty regular file as input");
+      return EXIT_FAILURE;
+    }
+    tiled_grid_t grid(input.view());
+    timer.lap("parse");
+    const auto result_1 = grid.eligible_rolls_1();
+    timer.lap("part 1");
+    const auto result_2 = grid.eligible_rolls_2();
+    timer.lap("part 2");
+    std::println("Solution part 1: {}", result_1);
+    std::println("Solution part 2: {}", result_2);
+    return EXIT_SUCCESS;
+  }
+  input_buffer input;
   std::string paper_rolls;
-  std::getline(std::cin, paper_rolls);
-  const int64_t columns = paper_rolls.size();
-  std::copy(std::istream_iterator<char>(std::cin),
-            std::istream_iterator<char>(), std::back_inserter(paper_rolls));
+  paper_rolls.reserve(input.view().size());
+  for (auto line : lines(input.view())) {
+    paper_rolls.append(line);
+  }
+  const int64_t columns =
+      std::min(input.view().find('\n'), input.view().size());
   // std::valarray<bool> val_rolls(paper_rolls.size());
   // std::transform(paper_rolls.cbegin(), paper_rolls.cend(),
   //                std::begin(val_rolls), [](char c) { return c == ROLL_C; });
   const int64_t rows = paper_rolls.size() / columns;
   cgrid_t grid = std::mdspan(paper_rolls.data(), rows, columns);
-  std::println("Solution part 1: {}", eligible_rolls_1(grid));
-  std::println("Solution part 2: {}", eligible_rolls_2(grid));
+  timer.lap("parse");
+  const auto result_1 =
+      char_grid ? eligible_rolls_1(grid) : eligible_rolls_1(bgrid_t(grid));
+  timer.lap("part 1");
+  const auto result_2 = eligible_rolls_2(grid);
+  timer.lap("part 2");
+  std::println("Solution part 1: {}", result_1);
+  std::println("Solution part 2: {}", result_2);
 }
@@ -0,0 +1,131 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <cstdint>
+#include <print>
+#include <ranges>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+using food_id_t = int64_t;
+
+const food_id_t MAX_ID = 1'000'000'000'000'000; // ids are below this
+const uint64_t RANGE_BYTES = 32;                 // about, with the newline
+const uint64_t UPDATE_ODDS = 8;
+
+// A quarter of the bytes are "lo-hi" ranges, in random order and possibly
+// overlapping, the rest are ids to look up. Range lengths are chosen so that
+// the ranges cover about two thirds of the ids.
+// For odd seeds, one line in UPDATE_ODDS among the ids is an update for
+// main --dynamic instead, "+lo-hi" adding a range or "-lo-hi" removing one.
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  rng_t rng(seed);
+  const auto n_ranges = std::max<uint64_t>(size / 4 / RANGE_BYTES, 1);
+  const auto mean_length = MAX_ID / static_cast<food_id_t>(n_ranges);
+  auto write_range = [&rng, &out, mean_length]() {
+    const auto lo = rng.uniform(1, MAX_ID - 1);
+    const auto hi = std::min(lo + rng.uniform(0, 2 * mean_length), MAX_ID - 1);
+    out << lo << '-' << hi << '\n';
+  };
+  for (auto i = 0uz; i < n_ranges; ++i) {
+    write_range();
+  }
+  out << '\n';
+  do {
+    if (seed % 2 == 1 && rng.chance(1, UPDATE_ODDS)) {
+      out << (rng.chance(1, 2) ? '+' : '-');
+      write_range();
+    } else {
+      out << rng.uniform(1, MAX_ID - 1) << '\n';
+    }
+  } while (out.size() < size);
+}
+
+// Ids looked up between updates, the obvious way: the latest range added or
+// removed that covers an id tells whether it is fresh, and part 2 adds up
+// the pieces between the ends of all the ranges that the latest one
+// covering them added. Quadratic, for update logs only.
+static void reference_updates(std::string_view input, std::size_t separator) {
+  // every range added or removed, in order, true when added
+  std::vector<std::pair<bool, std::pair<food_id_t, food_id_t>>> updates;
+  auto fresh = [&updates](food_id_t id) {
+    for (const auto &[added, range] : std::views::reverse(updates)) {
+      if (range.first <= id && id <= range.second) {
+        return added;
+      }
+    }
+    return false;
+  };
+  int64_t result_1{0};
+  for (auto line : lines(input)) {
+    const bool in_ranges = line.data() < input.data() + separator;
+    std::pair<food_id_t, food_id_t> range;
+    if (in_ranges || line.starts_with('+') || line.starts_with('-')) {
+      const bool added = in_ranges || line[0] == '+';
+      if (read_int(line, range.first) && read_int(line, range.second)) {
+        updates.emplace_back(added, range);
+      }
+    } else if (food_id_t id; read_int(line, id)) {
+      result_1 += fresh(id);
+    }
+  }
+
+  std::vector<food_id_t> ends;
+  for (const auto &[added, range] : updates) {
+    ends.push_back(range.first);
+    ends.push_back(range.second + 1);
+  }
+  std::ranges::sort(ends);
+  ends.erase(std::ranges::unique(ends).begin(), ends.end());
+  int64_t result_2{0};
+  for (auto i = 0uz; i + 1 < ends.size(); ++i) {
+    if (fresh(ends[i])) {
+      result_2 += ends[i + 1] - ends[i];
+    }
+  }
+  std::println("Solution part 1: {}", result_1);
+  std::println("Solution part 2: {}", result_2);
+}
+
+// Sort ranges and ids and sweep them together, keeping the furthest end of
+// the ranges started so far
+static void reference(std::string_view input) {
+  const auto separator = std::min(input.find("\n\n"), input.size());
+  if (input.find_first_of("+-", separator) != input.npos) {
+    reference_updates(input, separator);
+    return;
+  }
+  std::vector<std::pair<food_id_t, food_id_t>> ranges;
+  std::string_view text = input.substr(0, separator);
+  for (food_id_t lo{0}, hi{0}; read_int(text, lo) && read_int(text, hi);) {
+    ranges.emplace_back(lo, hi);
+  }
+  auto ids = read_ints<food_id_t>(input.substr(separator));
+  std::ranges::sort(ranges);
+  std::ranges::sort(ids);
+
+  int64_t result_1{0};
+  auto range = ranges.cbegin();
+  food_id_t reach{-1};
+  for (const auto id : ids) {
+    for (; range != ranges.cend() && range->first <= id; ++range) {
+      reach = std::max(reach, range->second);
+    }
+    result_1 += id <= reach;
+  }
+
+  int64_t result_2{0};
+  reach = -1;
+  for (const auto &[lo, hi] : ranges) {
+    result_2 += std::max<food_id_t>(0, hi - std::max(lo, reach + 1) + 1);
+    reach = std::max(reach, hi);
+  }
+  std::println("Solution part 1: {}", result_1);
+  std::println("Solution part 2: {}", result_2);
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
@@ -1,19 +1,28 @@
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
-#include <iostream>
+#include <functional>
 #include <iterator>
-#include <mdspan>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
 #include <print>
 #include <span>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include "bench.h"
+#include "fast_input.h"
+#include "parallel.h"
+
 using food_id_t = int64_t;
 
 class segment_tree {
@@ -104,27 +113,170 @@ private:
 
 using range_t = segment_tree::range_t;
 
-int main() {
-  std::println("Ciao, {}!", "Mondo");
-  // Parse ranges:
-  std::string line;
-  std::vector<range_t> ranges;
-  std::vector<food_id_t> queries;
-  while (std::getline(std::cin, line) && !line.empty()) {
-    std::istringstream sline{std::move(line)};
-    food_id_t l, r;
-    char dash;
-    sline >> l >> dash >> r;
-    ranges.emplace_back(l, r);
-  }
-  // Parse queries
-  std::copy(std::istream_iterator<food_id_t>(std::cin),
-            std::istream_iterator<food_id_t>(), std::back_inserter(queries));
-
-  std::ranges::sort(ranges);
+// Static index over sorted, disjoint ranges. The starts are laid out in
+// Eytzinger (breadth first) order, an implicit search tree where node k has
+// children 2k and 2k + 1, and the ends are in a parallel array. The top of
+// the tree shares a few cache lines, the descent is branchless and prefetches
+// the cache line holding the descendants PREFETCH_LEVELS levels down, so a
+// lookup costs a handful of cache misses, mostly overlapped.
+class eytzinger_index {
+public:
+  explicit eytzinger_index(std::span<const range_t> ranges)
+      : _levels(static_cast<std::size_t>(std::bit_width(ranges.size()))),
+        _size(std::max(std::size_t{1} << _levels, KEYS_PER_LINE)),
+        _starts(allocate(_size)), _ends(allocate(_size)) {
+    // padding nodes hold the largest start, so descents only go right there
+    // for the largest id, whose range is then the last one
+    std::fill_n(_starts.get(), _size, std::numeric_limits<food_id_t>::max());
+    std::fill_n(_ends.get(), _size,
+                ranges.empty() ? food_id_t{-1} : ranges.back().second);
+    _ends[0] = -1; // no range starts at or before the id
+    std::size_t next{0};
+    fill(ranges, next, 1);
+  }
+
+  bool contains(food_id_t id) const {
+    std::size_t k{1};
+    for (auto level = 0uz; level < _levels; ++level) {
+      prefetch(k);
+      k = 2 * k + (_starts[k] <= id);
+    }
+    return id <= _ends[last_right_turn(k)];
+  }
+
+  // found[i] = contains(ids[i]), with BATCH descents interleaved level by
+  // level, so that their cache misses overlap
+  void contains(std::span<const food_id_t> ids, std::span<bool> found) const {
+    assert(found.size() >= ids.size());
+    for (auto first = 0uz; first < ids.size(); first += BATCH) {
+      const auto batch =
+          ids.subspan(first, std::min(BATCH, ids.size() - first));
+      std::array<std::size_t, BATCH> k;
+      k.fill(1);
+      for (auto level = 0uz; level < _levels; ++level) {
+        for (auto i = 0uz; i < batch.size(); ++i) {
+          k[i] = 2 * k[i] + (_starts[k[i]] <= batch[i]);
+          prefetch(k[i]);
+        }
+      }
+      for (auto i = 0uz; i < batch.size(); ++i) {
+        found[first + i] = batch[i] <= _ends[last_right_turn(k[i])];
+      }
+    }
+  }
+
+private:
+  static constexpr std::size_t CACHE_LINE = 64;
+  static constexpr std::size_t KEYS_PER_LINE = CACHE_LINE / sizeof(food_id_t);
+  static constexpr std::size_t PREFETCH_LEVELS = 3; // KEYS_PER_LINE == 2^3
+  static constexpr std::size_t BATCH = 16;
+
+  using buffer_t = std::unique_ptr<food_id_t[], decltype(&std::free)>;
+
+  static buffer_t allocate(std::size_t n) {
+    return buffer_t(static_cast<food_id_t *>(
+                        std::aligned_alloc(CACHE_LINE, n * sizeof(food_id_t))),
+                    &std::free);
+  }
+
+  // In order traversal of the implicit tree, assigning the sorted ranges
+  void fill(std::span<const range_t> ranges, std::size_t &next,
+            std::size_t k) {
+    if (k > ranges.size()) {
+      return;
+    }
+    fill(ranges, next, 2 * k);
+    std::tie(_starts[k], _ends[k]) = ranges[next++];
+    fill(ranges, next, 2 * k + 1);
+  }
+
+  // The descendants of k PREFETCH_LEVELS levels down share one cache line
+  void prefetch(std::size_t k) const {
+    __builtin_prefetch(_starts.get() +
+                       std::min(k << PREFETCH_LEVELS, _size - 1));
+  }
+
+  // Node of the last right turn of the path ending in k: the range with the
+  // largest start not after the id, or 0 when there is none
+  static std::size_t last_right_turn(std::size_t k) {
+    return k >> (std::countr_zero(k) + 1);
+  }
+
+  std::size_t _levels;
+  std::size_t _size;
+  buffer_t _starts;
+  buffer_t _ends;
+};
+
+// Mutable set of ids, stored as disjoint ranges in a map from start to end.
+// insert merges the ranges it overlaps or touches, erase splits the ranges it
+// cuts, and both keep the number of ids in the set up to date, so updates
+// and lookups can be interleaved at O(log n) each (plus the ranges an insert
+// swallows, each of which it removes for good).
+class interval_set {
+public:
+  void insert(range_t range) {
+    auto [lo, hi] = range;
+    auto it = _ranges.upper_bound(lo);
+    if (it != _ranges.begin() && std::prev(it)->second >= lo - 1) {
+      --it;
+    }
+    while (it != _ranges.end() && it->first <= hi + 1) {
+      lo = std::min(lo, it->first);
+      hi = std::max(hi, it->second);
+      _total -= it->second - it->first + 1;
+      it = _ranges.erase(it);
+    }
+    _ranges.emplace_hint(it, lo, hi);
+    _total += hi - lo + 1;
+  }
+
+  void erase(range_t range) {
+    const auto [lo, hi] = range;
+    auto it = _ranges.upper_bound(lo);
+    if (it != _ranges.begin() && std::prev(it)->second >= lo) {
+      --it;
+    }
+    while (it != _ranges.end() && it->first <= hi) {
+      const auto [first, last] = *it;
+      _total -= last - first + 1;
+      it = _ranges.erase(it);
+      if (first < lo) { // keep the part before the erased range
+        _ranges.emplace_hint(it, first, lo - 1);
+        _total += lo - first;
+      }
+      if (last > hi) { // and the part after it
+        _ranges.emplace_hint(it, hi + 1, last);
+        _total += last - hi;
+      }
+    }
+  }
+
+  bool contains(food_id_t id) const {
+    const auto it = _ranges.upper_bound(id);
+    return it != _ranges.begin() && std::prev(it)->second >= id;
+  }
+
+  // Number of ids in the set
+  int64_t total() const { return _total; }
+  std::size_t size() const { return _ranges.size(); }
+  auto begin() const { return _ranges.cbegin(); }
+  auto end() const { return _ranges.cend(); }
+
+private:
+  std::map<food_id_t, food_id_t> _ranges;
+  int64_t _total{0};
+};
+
+// Merge the overlapping ranges of sorted, in place, and return how many
+// ranges are left
+std::size_t merge_sorted(std::span<range_t> sorted) {
+  if (sorted.empty()) {
+    return 0;
+  }
   // Remove redundant ranges
-  auto write_it = ranges.begin();
-  std::for_each(std::next(write_it), ranges.end(), [&write_it](auto range) {
+  auto write_it = sorted.begin();
+  std::for_each(std::next(write_it), sorted.end(), [&write_it](auto range) {
     if (write_it->second < range.first) {
       ++write_it;
       *write_it = range;
@@ -132,20 +284,380 @@ int main() {
       write_it->second = range.second;
     }
   });
-  ranges.erase(std::next(write_it), ranges.end());
-  // Part 1
-  segment_tree st(ranges);
+  return static_cast<std::size_t>(std::distance(sorted.begin(), write_it)) + 1;
+}
+
+// Bounds of part i of n_parts about equal parts of size elements
+std::pair<std::size_t, std::size_t> part_bounds(std::size_t size, std::size_t i,
+                                                std::size_t n_parts) {
+  return {size * i / n_parts, size * (i + 1) / n_parts};
+}
+
+// Parse the chunks of text concurrently, parse(chunk, values) appending the
+// values found in a chunk, and concatenate the results in input order
+template <class T, class F>
+std::vector<T> parse_chunks(std::string_view text, F parse) {
+  const auto chunks =
+      split_chunks(text, n_workers(text.size(), 1uz << 20), '\n');
+  std::vector<std::vector<T>> parts(chunks.size());
+  parallel_for(chunks.size(),
+               [&](std::size_t i) { parse(chunks[i], parts[i]); });
+  if (parts.size() == 1) {
+    return std::move(parts[0]);
+  }
+  std::vector<std::size_t> offsets(parts.size() + 1, 0);
+  for (auto i = 0uz; i < parts.size(); ++i) {
+    offsets[i + 1] = offsets[i] + parts[i].size();
+  }
+  std::vector<T> values(offsets.back());
+  parallel_for(parts.size(), [&](std::size_t i) {
+    std::ranges::copy(parts[i], values.begin() + static_cast<std::ptrdiff_t>(
+                                                     offsets[i]));
+  });
+  return values;
+}
+
+// Sample sort: splitters picked from an evenly spaced sample cut the ranges
+// in one bucket per worker, every worker counts how many of its ranges go to
+// each bucket, the counts give every (worker, bucket) pair its slot in the
+// output, and then the ranges are scattered and the buckets sorted, all
+// concurrently. Returns the sorted ranges and where each bucket starts.
+std::pair<std::vector<range_t>, std::vector<std::size_t>>
+sample_sort(const std::vector<range_t> &ranges, std::size_t n_buckets) {
+  const auto OVERSAMPLING = 64uz;
+  std::vector<range_t> sample;
+  const auto sample_size = std::min(n_buckets * OVERSAMPLING, ranges.size());
+  for (auto i = 0uz; i < sample_size; ++i) {
+    sample.push_back(ranges[part_bounds(ranges.size(), i, sample_size).first]);
+  }
+  std::ranges::sort(sample);
+  std::vector<range_t> splitters;
+  for (auto b = 1uz; b < n_buckets; ++b) {
+    splitters.push_back(sample[sample.size() * b / n_buckets]);
+  }
+  auto bucket_of = [&splitters](const range_t &range) {
+    return static_cast<std::size_t>(std::ranges::upper_bound(splitters, range) -
+                                    splitters.begin());
+  };
+
+  // counts[w * n_buckets + b]: ranges of worker w going to bucket b, turned
+  // into their offsets in the output
+  std::vector<std::size_t> counts(n_buckets * n_buckets, 0);
+  parallel_for(n_buckets, [&](std::size_t w) {
+    const auto [first, last] = part_bounds(ranges.size(), w, n_buckets);
+    for (auto i = first; i < last; ++i) {
+      ++counts[w * n_buckets + bucket_of(ranges[i])];
+    }
+  });
+  std::vector<std::size_t> bucket_starts(n_buckets + 1, 0);
+  std::size_t offset{0};
+  for (auto b = 0uz; b < n_buckets; ++b) {
+    bucket_starts[b] = offset;
+    for (auto w = 0uz; w < n_buckets; ++w) {
+      offset += std::exchange(counts[w * n_buckets + b], offset);
+    }
+  }
+  bucket_starts[n_buckets] = offset;
+
+  std::vector<range_t> sorted(ranges.size());
+  parallel_for(n_buckets, [&](std::size_t w) {
+    const auto [first, last] = part_bounds(ranges.size(), w, n_buckets);
+    for (auto i = first; i < last; ++i) {
+      sorted[counts[w * n_buckets + bucket_of(ranges[i])]++] = ranges[i];
+    }
+  });
+  parallel_for(n_buckets, [&](std::size_t b) {
+    std::sort(sorted.begin() + static_cast<std::ptrdiff_t>(bucket_starts[b]),
+              sorted.begin() +
+                  static_cast<std::ptrdiff_t>(bucket_starts[b + 1]));
+  });
+  return {std::move(sorted), std::move(bucket_starts)};
+}
+
+// Sort ranges and merge the overlapping ones.
+// With several workers the ranges are sample sorted, every bucket is merged
+// on its own, and a fix-up pass joins the buckets: the leading ranges of a
+// bucket that overlap the last range kept so far are folded into it, the
+// rest are copied to their place in the result concurrently.
+void merge_ranges(std::vector<range_t> &ranges) {
+  const auto n_buckets = n_workers(ranges.size(), 1uz << 16);
+  if (n_buckets == 1) {
+    std::ranges::sort(ranges);
+    ranges.resize(merge_sorted(ranges));
+    return;
+  }
+  auto [sorted, bucket_starts] = sample_sort(ranges, n_buckets);
+  std::vector<std::span<range_t>> merged(n_buckets);
+  parallel_for(n_buckets, [&](std::size_t b) {
+    const auto bucket = std::span(sorted).subspan(
+        bucket_starts[b], bucket_starts[b + 1] - bucket_starts[b]);
+    merged[b] = bucket.first(merge_sorted(bucket));
+  });
+
+  // Fix-up pass over the bucket boundaries
+  std::vector<std::size_t> skipped(n_buckets, 0);
+  std::vector<std::size_t> offsets(n_buckets + 1, 0);
+  range_t *last_kept{nullptr};
+  for (auto b = 0uz; b < n_buckets; ++b) {
+    auto &skip = skipped[b];
+    for (; last_kept && skip < merged[b].size() &&
+           merged[b][skip].first <= last_kept->second;
+         ++skip) {
+      last_kept->second = std::max(last_kept->second, merged[b][skip].second);
+    }
+    if (skip < merged[b].size()) {
+      last_kept = &merged[b].back();
+    }
+    offsets[b + 1] = offsets[b] + merged[b].size() - skip;
+  }
+  ranges.resize(offsets.back());
+  parallel_for(n_buckets, [&](std::size_t b) {
+    std::ranges::copy(merged[b].subspan(skipped[b]),
+                      ranges.begin() +
+                          static_cast<std::ptrdiff_t>(offsets[b]));
+  });
+}
+
+const unsigned RADIX_BITS = 11;
+
+// LSD radix sort of non-negative ids, RADIX_BITS at a time, up to the
+// highest digit of the largest id. scratch must be as large as ids.
+void radix_sort(std::span<food_id_t> ids, std::span<food_id_t> scratch) {
+  if (ids.empty()) {
+    return;
+  }
+  const auto max_id = static_cast<uint64_t>(std::ranges::max(ids));
+  auto from = ids;
+  auto to = scratch.first(ids.size());
+  for (auto shift = 0u; shift < 64 && (max_id >> shift) != 0;
+       shift += RADIX_BITS) {
+    auto digit = [shift](food_id_t id) {
+      return static_cast<std::size_t>(static_cast<uint64_t>(id) >> shift) &
+             ((1uz << RADIX_BITS) - 1);
+    };
+    std::array<std::size_t, 1uz << RADIX_BITS> offsets{};
+    for (const auto id : from) {
+      ++offsets[digit(id)];
+    }
+    std::exclusive_scan(offsets.cbegin(), offsets.cend(), offsets.begin(),
+                        0uz);
+    for (const auto id : from) {
+      to[offsets[digit(id)]++] = id;
+    }
+    std::swap(from, to);
+  }
+  if (from.data() != ids.data()) {
+    std::ranges::copy(from, ids.begin());
+  }
+}
+
+// Number of sorted ids that are in the merged ranges, in one merge pass.
+// Ranges that end before the next id are skipped by galloping, so sparse ids
+// do not pay for every range.
+int64_t count_fresh_sorted(std::span<const range_t> ranges,
+                           std::span<const food_id_t> ids) {
+  int64_t fresh{0};
+  const auto n_ranges = ranges.size();
+  auto r = 0uz;
+  for (const auto id : ids) {
+    if (r < n_ranges && ranges[r].second < id) {
+      auto step = 1uz;
+      while (r + step < n_ranges && ranges[r + step].second < id) {
+        r += step;
+        step *= 2;
+      }
+      const auto bracket =
+          ranges.subspan(r + 1, std::min(r + step, n_ranges) - r - 1);
+      r += 1 + static_cast<std::size_t>(
+                   std::ranges::lower_bound(bracket, id, {}, &range_t::second) -
+                   bracket.begin());
+    }
+    if (r == n_ranges) {
+      break;
+    }
+    fresh += ranges[r].first <= id;
+  }
+  return fresh;
+}
+
+// Split ids in one chunk per core, radix sort each chunk and sweep it against
+// the merged ranges, concurrently. ids are left sorted by chunk.
+int64_t count_fresh_batch(std::span<const range_t> ranges,
+                          std::span<food_id_t> ids) {
+  std::vector<food_id_t> scratch(ids.size());
+  const auto n_chunks = n_workers(ids.size(), 1uz << 16);
+  std::vector<int64_t> fresh(n_chunks, 0);
+  parallel_for(n_chunks, [&](std::size_t i) {
+    const auto first = ids.size() * i / n_chunks;
+    const auto size = ids.size() * (i + 1) / n_chunks - first;
+    const auto chunk = ids.subspan(first, size);
+    radix_sort(chunk, std::span(scratch).subspan(first, size));
+    fresh[i] = count_fresh_sorted(ranges, chunk);
+  });
+  return std::ranges::fold_left(fresh, 0z, std::plus<>());
+}
+
+// Ids are read from the stream and checked a run of MAX_RUN_IDS at a time:
+// counting is a sum over runs, so each run is sorted and swept on its own and
+// memory stays at one run, whatever the number of ids.
+const std::size_t MAX_RUN_IDS = 1uz << 24;
+
+// Read the ranges from stream, merge them into ranges, then count the ids
+// after them that are fresh
+int64_t count_fresh_streamed(line_stream &stream, std::vector<range_t> &ranges,
+                             phase_timer &timer) {
+  bool reading_ranges{true};
+  std::vector<food_id_t> run;
+  int64_t fresh{0};
+  for (auto block = stream.next(); !block.empty(); block = stream.next()) {
+    if (reading_ranges) {
+      for (auto line : lines(block)) {
+        food_id_t l, r;
+        if (read_int(line, l) && read_int(line, r)) {
+          ranges.emplace_back(l, r);
+        } else if (line.empty()) { // end of the ranges
+          reading_ranges = false;
+          block.remove_prefix(
+              static_cast<std::size_t>(line.data() - block.data()));
+          merge_ranges(ranges);
+          timer.lap("merge");
+          break;
+        }
+      }
+      if (reading_ranges) {
+        continue;
+      }
+    }
+    food_id_t id{};
+    while (read_int(block, id)) {
+      run.push_back(id);
+    }
+    if (run.size() >= MAX_RUN_IDS) {
+      fresh += count_fresh_batch(ranges, run);
+      run.clear();
+    }
+  }
+  if (reading_ranges) { // no ids at all
+    merge_ranges(ranges);
+    timer.lap("merge");
+  }
+  return fresh + count_fresh_batch(ranges, run);
+}
+
+// Look up the ids of log in order, applying the updates found between them
+// as they come: a line "+lo-hi" adds a range to set, "-lo-hi" removes one,
+// any other line holds an id. Returns the ids that were fresh when looked up.
+static int64_t count_fresh_online(std::string_view log, interval_set &set) {
+  int64_t fresh{0};
+  for (auto line : lines(log)) {
+    range_t range;
+    if (line.starts_with('+') || line.starts_with('-')) {
+      const bool insert = line[0] == '+';
+      if (read_int(line, range.first) && read_int(line, range.second)) {
+        if (insert) {
+          set.insert(range);
+        } else {
+          set.erase(range);
+        }
+      }
+    } else if (food_id_t id; read_int(line, id)) {
+      fresh += set.contains(id);
+    }
+  }
+  return fresh;
+}
+
+int main(int argc, char *argv[]) {
+  std::println("Ciao, {}!", "Mondo");
+  const std::vector<std::string_view> options(argv + 1, argv + argc);
+  // --segment-tree answers part 1 with the segment tree instead of the
+  // Eytzinger index
+  const bool use_segment_tree =
+      std::ranges::find(options, "--segment-tree") != options.end();
+  // --sort-merge streams the ids in runs, radix sorting each run and
+  // sweeping it against the ranges, so that they need not fit in memory
+  const bool sort_merge =
+      std::ranges::find(options, "--sort-merge") != options.end();
+  // --dynamic adds the ranges one by one to an interval_set, which keeps
+  // them merged and counts the fresh ids as it goes, then reads the ids in
+  // order, along with "+lo-hi" and "-lo-hi" lines between them that add and
+  // remove ranges; part 2 counts the ids fresh at the end. The other modes
+  // do not read these lines, and --sort-merge ignores --dynamic.
+  const bool dynamic =
+      !sort_merge && std::ranges::find(options, "--dynamic") != options.end();
+  phase_timer timer;
+  std::vector<range_t> ranges;
+  interval_set fresh_set;
   int64_t fresh_ingredients{0};
-  for (auto q : queries) {
-    bool present = st.is_present(q);
-    fresh_ingredients += present;
+  if (sort_merge) {
+    line_stream stream(STDIN_FILENO);
+    fresh_ingredients = count_fresh_streamed(stream, ranges, timer);
+  } else {
+    // Ranges and queries are separated by an empty line
+    input_buffer input;
+    const auto separator =
+        std::min(input.view().find("\n\n"), input.view().size());
+    // Parse ranges and queries, a chunk of lines per worker
+    ranges = parse_chunks<range_t>(
+        input.view().substr(0, separator),
+        [](std::string_view chunk, std::vector<range_t> &values) {
+          for (auto line : lines(chunk)) {
+            food_id_t l, r;
+            if (read_int(line, l) && read_int(line, r)) {
+              values.emplace_back(l, r);
+            }
+          }
+        });
+    std::vector<food_id_t> queries;
+    if (!dynamic) { // read online instead
+      queries = parse_chunks<food_id_t>(
+          input.view().substr(separator),
+          [](std::string_view chunk, std::vector<food_id_t> &values) {
+            values = read_ints<food_id_t>(chunk);
+          });
+    }
+    timer.lap("parse");
+
+    if (dynamic) {
+      for (const auto &range : ranges) {
+        fresh_set.insert(range);
+      }
+    } else {
+      merge_ranges(ranges);
+    }
+    timer.lap("merge");
+    // Part 1
+    if (dynamic) {
+      fresh_ingredients =
+          count_fresh_online(input.view().substr(separator), fresh_set);
+    } else if (use_segment_tree) {
+      segment_tree st(ranges);
+      for (auto q : queries) {
+        bool present = st.is_present(q);
+        fresh_ingredients += present;
+      }
+    } else {
+      const eytzinger_index index(ranges);
+      std::array<bool, 4096> found;
+      for (auto first = 0uz; first < queries.size(); first += found.size()) {
+        const auto batch = std::span(queries).subspan(
+            first, std::min(found.size(), queries.size() - first));
+        index.contains(batch, found);
+        fresh_ingredients +=
+            std::ranges::count(std::span(found).first(batch.size()), true);
+      }
+    }
   }
+  timer.lap("part 1");
   // Part 2
   int64_t total_fresh_ingredients =
-      std::ranges::fold_left(ranges, 0z, [](food_id_t acc, range_t r) {
-        auto values = r.second - r.first + 1;
-        return acc + values;
-      });
+      dynamic ? fresh_set.total()
+              : std::ranges::fold_left(ranges, 0z,
+                                       [](food_id_t acc, range_t r) {
+                                         auto values = r.second - r.first + 1;
+                                         return acc + values;
+                                       });
+  timer.lap("part 2");
 
   std::println("Solution part 1: {}", fresh_ingredients);
   std::println("Solution part 2: {}", total_fresh_ingredients);
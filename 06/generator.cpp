@@ -0,0 +1,124 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "generator.h"
+
+const std::size_t N_OPERANDS = 4;
+const uint64_t PROBLEM_BYTES = 17; // about, separators included
+
+// Shape of a problem: operator, width and the number of digits of each
+// operand. Operands are all left or all right aligned and their lengths are
+// sorted, up or down, so that the digits of every column are contiguous and
+// can be read top to bottom. Products are at most two columns wide, to keep
+// the results in an int64_t.
+struct problem_t {
+  char op;
+  bool right_aligned;
+  int64_t width;
+  std::array<int64_t, N_OPERANDS> lengths;
+
+  problem_t(uint64_t seed, uint64_t index) {
+    rng_t rng(hash64(seed, index));
+    op = rng.chance(1, 2) ? '+' : '*';
+    width = rng.uniform(1, op == '+' ? 4 : 2);
+    right_aligned = rng.chance(1, 2);
+    for (auto &length : lengths) {
+      length = rng.uniform(1, width);
+    }
+    lengths[static_cast<std::size_t>(
+        rng.uniform(0, std::ssize(lengths) - 1))] = width; // no empty column
+    if (rng.chance(1, 2)) {
+      std::ranges::sort(lengths);
+    } else {
+      std::ranges::sort(lengths, std::ranges::greater());
+    }
+  }
+};
+
+// N_OPERANDS rows of operands and a row of operators. The worksheet is
+// written a row at a time and every row needs the shape of every problem,
+// so the shapes are recomputed from (seed, problem index) instead of stored.
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  const auto n_problems = std::max<uint64_t>(size / PROBLEM_BYTES, 1);
+  std::string field;
+  for (auto row = 0uz; row <= N_OPERANDS; ++row) {
+    rng_t digits(hash64(~seed, row));
+    for (auto i = 0uz; i < n_problems; ++i) {
+      const problem_t problem(seed, i);
+      field.assign(static_cast<std::size_t>(problem.width), ' ');
+      if (row == N_OPERANDS) {
+        field[0] = problem.op;
+      } else {
+        const auto length = problem.lengths[row];
+        const auto first = problem.right_aligned ? problem.width - length : 0;
+        for (auto j = first; j < first + length; ++j) {
+          field[static_cast<std::size_t>(j)] =
+              static_cast<char>('0' + digits.uniform(1, 9));
+        }
+      }
+      out << (i == 0 ? "" : " ") << std::string_view(field);
+    }
+    out << '\n';
+  }
+}
+
+// Cut the worksheet into problems at the columns that are blank in every
+// row, then read the operands of each problem by rows and by columns
+static void reference(std::string_view input) {
+  std::vector<std::string_view> rows;
+  for (auto line : lines(input)) {
+    if (!line.empty()) {
+      rows.push_back(line);
+    }
+  }
+  const auto operators = rows.back();
+  rows.pop_back();
+  const auto width = operators.size();
+  auto blank = [&rows, &operators](std::size_t col) {
+    return operators[col] == ' ' &&
+           std::ranges::all_of(rows, [col](auto r) { return r[col] == ' '; });
+  };
+
+  unsigned __int128 result_1{0};
+  unsigned __int128 result_2{0};
+  for (auto begin = 0uz; begin < width;) {
+    auto end = begin;
+    while (end < width && !blank(end)) {
+      ++end;
+    }
+    const char op = operators[begin];
+    unsigned __int128 by_rows = op == '+' ? 0 : 1;
+    for (auto row : rows) {
+      uint64_t operand{0};
+      auto field = row.substr(begin, end - begin);
+      read_int(field, operand);
+      by_rows = op == '+' ? by_rows + operand : by_rows * operand;
+    }
+    unsigned __int128 by_columns = op == '+' ? 0 : 1;
+    for (auto col = begin; col < end; ++col) {
+      uint64_t operand{0};
+      for (auto row : rows) {
+        if (row[col] != ' ') {
+          operand = operand * 10 + static_cast<uint64_t>(row[col] - '0');
+        }
+      }
+      by_columns = op == '+' ? by_columns + operand : by_columns * operand;
+    }
+    result_1 += by_rows;
+    result_2 += by_columns;
+    begin = end + 1;
+  }
+  std::println("Solution part 1: {}", to_string_128(result_1));
+  std::println("Solution part 2: {}", to_string_128(result_2));
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
@@ -1,113 +1,222 @@
 #include <algorithm>
-#include <array>
 #include <cassert>
-#include <charconv>
-#include <concepts>
 #include <cstddef>
 #include <cstdint>
-#include <cstdlib>
-#include <functional>
-#include <iostream>
-#include <istream>
-#include <iterator>
-#include <mdspan>
-#include <ostream>
 #include <print>
-#include <span>
-#include <sstream>
-#include <string>
-#include <utility>
+#include <string_view>
 #include <vector>
 
-int main() {
-  std::println("Ciao, {}!", "Mondo");
-  // Part 1
-  std::string line;
-  std::istringstream sline;
-  std::vector<int64_t> numbers;
+#include "bench.h"
+#include "fast_input.h"
+#include "parallel.h"
+
+static bool is_sum(char c) { return c == '+'; }
+static bool is_product(char c) { return c == '*'; }
+static bool is_operator(char c) { return is_sum(c) || is_product(c); }
+
+// The operand rows and the operator row, as views into the input. Every
+// problem starts at the column of its operator and ends before the next one.
+struct worksheet_t {
+  std::vector<std::string_view> rows;
+  std::string_view operators;
+};
+
+struct results_t {
+  int64_t part_1{0};
+  int64_t part_2{0};
+};
+
+// Columns evaluated at once: the slice of every row and the column
+// accumulators of a block stay in cache
+const std::size_t BLOCK_COLUMNS = 1 << 12;
+
+// Evaluate the problems starting in the columns [begin, end), begin and end
+// being problem starts or the end of the worksheet. The block is read a row
+// at a time, left to right, and every digit updates both the number of its
+// problem in that row (part 1) and the number of its column (part 2), so the
+// worksheet is never transposed.
+// Part 1 is reduced a row at a time too: the numbers of the row go through
+// a sum and a product accumulator per problem, with an operator mask that
+// makes the other one add 0 or multiply by 1, so that the reduction loops
+// have no branch and are vectorized.
+static results_t evaluate_block(const worksheet_t &sheet, std::size_t begin,
+                                std::size_t end) {
+  std::vector<std::size_t> starts;
   std::vector<char> operators;
-  std::size_t n_operands{0};
-  auto is_sum = [](auto c) { return c == '+'; };
-  auto is_product = [](auto c) { return c == '*'; };
-  auto is_operator = [&is_sum, &is_product](auto c) {
-    return is_sum(c) || is_product(c);
-  };
-  std::string full_input; // Part 2
-  // Parse input
-  while (std::getline(std::cin, line) && !is_operator(line[0])) {
-    ++n_operands;
-    full_input.append(line);
-    full_input.push_back(' ');
+  for (auto col = begin; col < end; ++col) {
+    if (is_operator(sheet.operators[col])) {
+      starts.push_back(col - begin);
+      operators.push_back(sheet.operators[col]);
+    }
   }
-  // Parse operands
-  sline = std::istringstream(full_input);
-  std::copy(std::istream_iterator<int64_t>(sline),
-            std::istream_iterator<int64_t>(), std::back_inserter(numbers));
-  // Parse operators
-  full_input.append(line);
-  full_input.push_back(' ');
-  sline = std::istringstream(std::move(line));
-  std::copy(std::istream_iterator<char>(sline), std::istream_iterator<char>(),
-            std::back_inserter(operators));
+  const auto n_problems = operators.size();
+  starts.push_back(end - begin);
 
-  // Solution Part 1
-  const auto n_problems = std::size(operators);
-  assert(std::size(numbers) % n_problems == 0);
-  assert(std::size(numbers) / n_problems == n_operands);
-  const auto operands = std::mdspan(numbers.data(), n_operands, n_problems);
-  int64_t result_1{0};
-  for (auto col = 0uz; col < n_problems; ++col) {
-    const bool sum = is_sum(operators[col]);
-    int64_t solution = sum ? 0 : 1;
-    for (auto row = 0uz; row < n_operands; ++row) {
-      if (sum) {
-        solution += operands[row, col];
-      } else {
-        assert(operators[col] == '*');
-        solution *= operands[row, col];
+  // all ones for a sum, all zeros for a product
+  std::vector<int64_t> sum_masks(n_problems);
+  for (auto p = 0uz; p < n_problems; ++p) {
+    sum_masks[p] = is_sum(operators[p]) ? -1 : 0;
+  }
+  std::vector<int64_t> numbers(n_problems);
+  std::vector<int64_t> sums(n_problems, 0);
+  std::vector<int64_t> products(n_problems, 1);
+  std::vector<int64_t> columns(end - begin, 0);
+  std::vector<unsigned char> has_digits(end - begin, 0);
+  for (const auto row : sheet.rows) {
+    // rows shorter than the operator row are padded with blanks
+    const auto slice = row.substr(std::min(begin, row.size()), end - begin);
+    for (auto p = 0uz; p < n_problems; ++p) {
+      int64_t number{0};
+      bool found{false};
+      const auto last = std::min(starts[p + 1], slice.size());
+      for (auto col = starts[p]; col < last; ++col) {
+        const auto digit = slice[col] - '0';
+        if (digit >= 0 && digit <= 9) {
+          number = number * 10 + digit;
+          columns[col] = columns[col] * 10 + digit;
+          has_digits[col] = 1;
+          found = true;
+        }
       }
+      // a blank operand leaves the solution as it is
+      numbers[p] = found ? number : 1 & ~sum_masks[p];
+    }
+    for (auto p = 0uz; p < n_problems; ++p) {
+      sums[p] += numbers[p] & sum_masks[p];
+    }
+    for (auto p = 0uz; p < n_problems; ++p) {
+      products[p] *= (numbers[p] & ~sum_masks[p]) | (1 & sum_masks[p]);
     }
-    result_1 += solution;
   }
 
-  // Solution Part 2
-  const auto input_rows = n_operands + 1;
-  assert(std::size(full_input) % input_rows == 0);
-  const auto input_cols = std::size(full_input) / input_rows;
-  const auto input_grid =
-      std::mdspan(full_input.data(), input_rows, input_cols);
+  results_t results;
+  for (auto p = 0uz; p < n_problems; ++p) {
+    results.part_1 += sums[p] + (products[p] & ~sum_masks[p]);
+    int64_t solution = is_sum(operators[p]) ? 0 : 1;
+    for (auto col = starts[p]; col < starts[p + 1]; ++col) {
+      if (has_digits[col]) {
+        solution = is_sum(operators[p]) ? solution + columns[col]
+                                        : solution * columns[col];
+      }
+    }
+    results.part_2 += solution;
+  }
+  return results;
+}
 
-  std::string transposed_input;
-  transposed_input.reserve(full_input.size());
-  auto back_inserter = std::back_inserter(transposed_input);
-  for (auto col = 1uz; col <= input_cols; ++col) {
-    for (auto row = 0uz; row < input_rows; ++row) {
-      back_inserter = input_grid[row, input_cols - col];
+// Evaluate the whole worksheet in blocks of about BLOCK_COLUMNS, cut at
+// problem starts. Every worker evaluates a range of consecutive blocks, found
+// as it goes, and calls done(begin, end) with the columns of each block it
+// has evaluated.
+template <class F> static results_t evaluate(const worksheet_t &sheet, F done) {
+  const auto width = sheet.operators.size();
+  // first problem start at or after col
+  auto problem_start = [&sheet, width](std::size_t col) {
+    return std::min(sheet.operators.find_first_of("+*", col), width);
+  };
+  const auto n_tasks = n_workers(width, 16 * BLOCK_COLUMNS);
+  std::vector<results_t> partials(n_tasks);
+  parallel_for(n_tasks, [&](std::size_t task) {
+    const auto last = problem_start(width * (task + 1) / n_tasks);
+    for (auto begin = problem_start(width * task / n_tasks); begin < last;) {
+      const auto end = std::min(problem_start(begin + BLOCK_COLUMNS), last);
+      const auto block = evaluate_block(sheet, begin, end);
+      partials[task].part_1 += block.part_1;
+      partials[task].part_2 += block.part_2;
+      done(begin, end);
+      begin = end;
     }
+  });
+  results_t results;
+  for (const auto &partial : partials) {
+    results.part_1 += partial.part_1;
+    results.part_2 += partial.part_2;
   }
+  return results;
+}
 
-  const auto row_width = static_cast<int64_t>(input_rows);
-  auto is_whitespace = [](auto c) { return c == ' '; };
-  std::vector<int64_t> operands_v = {};
-  operands_v.reserve(8);
-  int64_t result_2{0};
-  for (auto it = transposed_input.cbegin(); it < transposed_input.cend();
-       std::advance(it, row_width)) {
-    const auto view_end = std::next(it, row_width);
-    const auto view_begin = std::find_if_not(it, view_end, is_whitespace);
-    if (view_begin == view_end) {
-      continue;
+// The rows of the input when they all are as wide as the first one, found
+// from their offsets alone. Only the first row is scanned, a window at a
+// time, each window dropped once scanned. Empty when the rows differ.
+static std::vector<std::string_view> uniform_rows(const input_buffer &input) {
+  const auto text = input.view();
+  const auto WINDOW = 1uz << 20;
+  auto width = std::string_view::npos;
+  for (auto first = 0uz; first < text.size() && width == text.npos;
+       first += WINDOW) {
+    const auto window = text.substr(first, WINDOW);
+    if (const auto newline = window.find('\n'); newline != text.npos) {
+      width = first + newline;
+    }
+    input.release(window);
+  }
+  if (width == text.npos) {
+    return {};
+  }
+  const auto stride = width + 1;
+  // the last newline is optional
+  const auto n_rows = (text.size() + 1) / stride;
+  if (n_rows * stride < text.size()) {
+    return {};
+  }
+  std::vector<std::string_view> rows;
+  for (auto row = 0uz; row < n_rows; ++row) {
+    const auto newline = row * stride + width;
+    if (newline < text.size() && text[newline] != '\n') {
+      return {};
     }
-    auto const row = std::string_view{view_begin, view_end};
-    operands_v.push_back(std::strtol(row.data(), nullptr, 10));
-    if (is_sum(row.back())) {
-      result_2 += std::ranges::fold_left(operands_v, 0l, std::plus());
-      operands_v.clear();
-    } else if (is_product(row.back())) {
-      result_2 += std::ranges::fold_left(operands_v, 1l, std::multiplies());
-      operands_v.clear();
+    rows.push_back(text.substr(row * stride, width));
+  }
+  return rows;
+}
+
+int main(int argc, char *argv[]) {
+  std::println("Ciao, {}!", "Mondo");
+  const std::vector<std::string_view> options(argv + 1, argv + argc);
+  // --stream finds the rows of a mapped worksheet from their offsets and
+  // drops the pages of every block once evaluated, so that what stays
+  // resident is about the blocks in flight, however wide the rows are
+  const bool stream = std::ranges::find(options, "--stream") != options.end();
+  // Parse input
+  phase_timer timer;
+  input_buffer input;
+  worksheet_t sheet;
+  if (stream && input.is_mapped()) {
+    sheet.rows = uniform_rows(input);
+  }
+  if (!sheet.rows.empty() && !sheet.rows.back().empty() &&
+      is_operator(sheet.rows.back()[0])) {
+    sheet.operators = sheet.rows.back();
+    sheet.rows.pop_back();
+  } else {
+    sheet.rows.clear();
+    for (auto line : lines(input.view())) {
+      if (line.empty()) {
+        continue;
+      }
+      if (is_operator(line[0])) {
+        sheet.operators = line;
+        break;
+      }
+      sheet.rows.push_back(line);
     }
   }
+  assert(!sheet.operators.empty());
+  timer.lap("parse");
+
+  // Solution Part 1 and 2, in one pass
+  const auto [result_1, result_2] =
+      evaluate(sheet, [&](std::size_t begin, std::size_t end) {
+        if (!stream) {
+          return;
+        }
+        for (const auto row : sheet.rows) {
+          input.release(row.substr(std::min(begin, row.size()), end - begin));
+        }
+        input.release(sheet.operators.substr(begin, end - begin));
+      });
+  timer.lap("evaluate");
+
   std::println("Solution part 1: {}", result_1);
   std::println("Solution part 2: {}", result_2);
 }
@@ -0,0 +1,99 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+const char START_C = 'S';
+const char SPLIT_C = '^';
+const char EMPTY_C = '.';
+
+// Every splitter at most doubles the timelines going through it, 150 rows of
+// splitters keep the number of timelines well inside an int64_t
+const uint64_t MAX_SPLITTER_ROWS = 150;
+
+// The start in a random column of the first row, then about as many rows as
+// the manifold is wide, up to MAX_SPLITTER_ROWS of which hold splitters,
+// spread evenly, the others being empty. Splitters come alone or in runs like
+// "^^", whose beams land on the same columns, and each border holds one in
+// half of the splitter rows, sending a beam out of the manifold.
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  rng_t rng(seed);
+  const auto side =
+      static_cast<uint64_t>(std::sqrt(static_cast<double>(size)));
+  const auto n_rows = std::max<uint64_t>(side, 2);
+  const auto splitter_rows = std::min(n_rows / 2, MAX_SPLITTER_ROWS);
+  const auto width = std::max<uint64_t>(size / (n_rows + 1), 3);
+  const auto start = static_cast<std::size_t>(
+      rng.uniform(0, static_cast<int64_t>(width) - 1));
+  std::string row(width, EMPTY_C);
+  row[start] = START_C;
+  out << std::string_view(row) << '\n';
+  row[start] = EMPTY_C;
+  for (auto i = 0uz; i < n_rows; ++i) {
+    // row i holds splitters when it ends a new n_rows / splitter_rows band
+    if ((i + 1) * splitter_rows / n_rows == i * splitter_rows / n_rows) {
+      out << std::string_view(row) << '\n';
+      continue;
+    }
+    std::string splitters(width, EMPTY_C);
+    for (auto col = 0uz; col < width; ++col) {
+      const bool border = col == 0 || col + 1 == width;
+      const bool in_run = col > 0 && splitters[col - 1] == SPLIT_C;
+      if (rng.chance(1, border ? 2 : in_run ? 3 : 4)) {
+        splitters[col] = SPLIT_C;
+      }
+    }
+    out << std::string_view(splitters) << '\n';
+  }
+}
+
+// Follow the number of timelines in every column, row by row
+static void reference(std::string_view input) {
+  std::vector<unsigned __int128> timelines;
+  int64_t result_1{0};
+  for (auto line : lines(input)) {
+    if (line.empty()) {
+      continue;
+    }
+    if (timelines.empty()) {
+      timelines.resize(line.size());
+      timelines[line.find(START_C)] = 1;
+      continue;
+    }
+    std::vector<unsigned __int128> next(timelines.size());
+    for (auto col = 0uz; col < line.size(); ++col) {
+      if (timelines[col] == 0) {
+        continue;
+      }
+      if (line[col] == SPLIT_C) { // beams leaving the manifold are dropped
+        ++result_1;
+        if (col > 0) {
+          next[col - 1] += timelines[col];
+        }
+        if (col + 1 < next.size()) {
+          next[col + 1] += timelines[col];
+        }
+      } else {
+        next[col] += timelines[col];
+      }
+    }
+    timelines = std::move(next);
+  }
+  unsigned __int128 result_2{0};
+  for (const auto count : timelines) {
+    result_2 += count;
+  }
+  std::println("Solution part 1: {}", result_1);
+  std::println("Solution part 2: {}", to_string_128(result_2));
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
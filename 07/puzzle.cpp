@@ -1,76 +1,365 @@
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
-#include <iostream>
-#include <iterator>
-#include <mdspan>
+#include <optional>
 #include <print>
+#include <ranges>
 #include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include "bench.h"
+#include "fast_input.h"
+
 const char START_C = 'S';
 const char SPLIT_C = '^';
 const char EMPTY_C = '.';
 
-int main() {
-  std::println("Ciao, {}!", "Mondo");
-  std::string line;
-  auto is_splitter = [](auto c) { return c == SPLIT_C; };
-  std::string full_input;
-  // Parse input
-  std::getline(std::cin, full_input);
-  const auto manifold_width = std::size(full_input);
-  while (std::getline(std::cin, line)) {
-    full_input.append(std::move(line));
+namespace swar {
+// High bit set in exactly the bytes of chunk equal to c
+inline uint64_t equal_bytes_exact(uint64_t chunk, char c) {
+  const auto v = chunk ^ (ONES * static_cast<unsigned char>(c));
+  return ~(((v & ~HIGH_BITS) + ~HIGH_BITS) | v) & HIGH_BITS;
+}
+
+// The high bits of the 8 bytes of flags packed in the low 8 bits, byte i
+// of memory giving bit i
+inline uint64_t pack_high_bits(uint64_t flags) {
+  return ((flags >> 7) * 0x0102040810204080ull) >> 56;
+}
+} // namespace swar
+
+using word_t = uint64_t;
+const std::size_t WORD_BITS = 64;
+
+// Set bit w of mask when row[w] == c, for all the words of mask
+static void row_mask(std::string_view row, char c, std::span<word_t> mask) {
+  for (auto i = 0uz; i < mask.size(); ++i) {
+    const auto first = std::min(i * WORD_BITS, row.size());
+    const auto bytes = row.substr(first, WORD_BITS);
+    word_t word{0};
+    auto byte = 0uz;
+    if constexpr (std::endian::native == std::endian::little) {
+      for (; byte + 8 <= bytes.size(); byte += 8) {
+        const auto flags =
+            swar::equal_bytes_exact(swar::load(bytes.data() + byte), c);
+        word |= swar::pack_high_bits(flags) << byte;
+      }
+    }
+    for (; byte < bytes.size(); ++byte) {
+      word |= word_t{bytes[byte] == c} << byte;
+    }
+    mask[i] = word;
+  }
+}
+
+// Dense engine: the beams are the bits of 64-bit words, one per column, and
+// the timelines a count per column. A row is advanced a word at a time:
+//   hit = beams & splitters, beams = (beams & ~hit) | hit << 1 | hit >> 1
+// and the timelines of a column are its own when not hit plus those of its
+// hit neighbours, picked with masks spread from the same hit words. Both
+// buffers are overwritten whole and swapped, never cleared.
+class beam_state {
+public:
+  explicit beam_state(std::string_view first_row)
+      : _width(first_row.size()),
+        _n_words((_width + WORD_BITS - 1) / WORD_BITS), _beams(_n_words, 0),
+        _new_beams(_n_words, 0), _splitters(_n_words, 0), _hits(_n_words, 0),
+        _timelines(_n_words * WORD_BITS + 2, 0),
+        _new_timelines(_timelines.size(), 0) {
+    const auto start = first_row.find(START_C);
+    assert(start != first_row.npos);
+    _beams[start / WORD_BITS] = word_t{1} << (start % WORD_BITS);
+    _timelines[start + 1] = 1;
+  }
+
+  void advance(std::string_view row) {
+    row_mask(row, SPLIT_C, _splitters);
+    for (auto i = 0uz; i < _n_words; ++i) {
+      _hits[i] = _beams[i] & _splitters[i];
+      _splits += std::popcount(_hits[i]);
+    }
+    for (auto i = 0uz; i < _n_words; ++i) {
+      // hits in the column to the left and to the right of every bit
+      const auto left = _hits[i] << 1 | (i > 0 ? _hits[i - 1] >> 63 : 0);
+      const auto right =
+          _hits[i] >> 1 | (i + 1 < _n_words ? _hits[i + 1] << 63 : 0);
+      _new_beams[i] = (_beams[i] & ~_hits[i]) | left | right;
+      // _timelines[c + 1] holds column c, with a zero on either side
+      const auto first = i * WORD_BITS + 1;
+      const auto timelines = std::span(_timelines).subspan(first - 1);
+      const auto new_timelines = std::span(_new_timelines).subspan(first);
+      if ((_hits[i] | left | right) == 0) {
+        std::copy_n(timelines.begin() + 1, WORD_BITS, new_timelines.begin());
+        continue;
+      }
+      std::array<int64_t, WORD_BITS> own, from_left, from_right;
+      for (auto b = 0uz; b < WORD_BITS; ++b) {
+        own[b] = -static_cast<int64_t>((~_hits[i] >> b) & 1);
+        from_left[b] = -static_cast<int64_t>((left >> b) & 1);
+        from_right[b] = -static_cast<int64_t>((right >> b) & 1);
+      }
+      for (auto b = 0uz; b < WORD_BITS; ++b) {
+        new_timelines[b] = (timelines[b + 1] & own[b]) +
+                           (timelines[b] & from_left[b]) +
+                           (timelines[b + 2] & from_right[b]);
+      }
+    }
+    // beams leaving the manifold on the right are dropped, as those leaving
+    // it on the left are
+    if (const auto tail = _width % WORD_BITS; tail != 0) {
+      _new_beams.back() &= (word_t{1} << tail) - 1;
+      std::ranges::fill(std::span(_new_timelines).subspan(_width + 1), 0);
+    }
+    std::swap(_beams, _new_beams);
+    std::swap(_timelines, _new_timelines);
+  }
+
+  int64_t splits() const { return _splits; }
+  int64_t timelines() const {
+    return std::ranges::fold_left(_timelines, int64_t{0}, std::plus());
+  }
+
+private:
+  std::size_t _width;
+  std::size_t _n_words;
+  std::vector<word_t> _beams;
+  std::vector<word_t> _new_beams;
+  std::vector<word_t> _splitters;
+  std::vector<word_t> _hits;
+  std::vector<int64_t> _timelines;
+  std::vector<int64_t> _new_timelines;
+  int64_t _splits{0};
+};
+
+// Sparse engine, for wide manifolds with few beams: the frontier is the
+// sorted list of the lit columns with their timelines. Every row looks up
+// the splitters under the frontier only, and a split writes its two beams
+// in order, merged with the previous one when they land on the same column,
+// so the cost of a row is about the number of beams, whatever the width.
+// Under "^^" the left beam of the second splitter lands before the right
+// beam of the first one, and is merged or inserted in its place. Beams that
+// leave the manifold on either side are dropped.
+class sparse_beam_state {
+public:
+  explicit sparse_beam_state(std::string_view first_row) {
+    const auto start = first_row.find(START_C);
+    assert(start != first_row.npos);
+    _frontier.emplace_back(start, 1);
+  }
+
+  void advance(std::string_view row) {
+    _new_frontier.clear();
+    auto emit = [this](std::size_t column, int64_t timelines) {
+      if (_new_frontier.empty() || _new_frontier.back().first < column) {
+        _new_frontier.emplace_back(column, timelines);
+      } else if (_new_frontier.back().first == column) {
+        _new_frontier.back().second += timelines;
+      } else if (const auto it = std::ranges::lower_bound(
+                     _new_frontier, column, {}, &beam_t::first);
+                 it->first == column) {
+        it->second += timelines;
+      } else {
+        _new_frontier.emplace(it, column, timelines);
+      }
+    };
+    for (const auto &[column, timelines] : _frontier) {
+      if (column < row.size() && row[column] == SPLIT_C) {
+        ++_splits;
+        if (column > 0) {
+          emit(column - 1, timelines);
+        }
+        if (column + 1 < row.size()) {
+          emit(column + 1, timelines);
+        }
+      } else {
+        emit(column, timelines);
+      }
+    }
+    assert(std::ranges::adjacent_find(_new_frontier,
+                                      std::ranges::greater_equal(),
+                                      &beam_t::first) == _new_frontier.end());
+    std::swap(_frontier, _new_frontier);
+  }
+
+  int64_t splits() const { return _splits; }
+  int64_t timelines() const {
+    return std::ranges::fold_left(_frontier | std::views::values, int64_t{0},
+                                  std::plus());
+  }
+
+private:
+  // a lit column and its timelines
+  using beam_t = std::pair<std::size_t, int64_t>;
+
+  std::vector<beam_t> _frontier;
+  std::vector<beam_t> _new_frontier;
+  int64_t _splits{0};
+};
+
+// Follow the beams from the first row to the last, returning the splits and
+// the timelines
+template <class State>
+static std::pair<int64_t, int64_t>
+solve(std::span<const std::string_view> rows) {
+  State state(rows.front());
+  for (const auto row : rows.subspan(1)) {
+    state.advance(row);
+  }
+  return {state.splits(), state.timelines()};
+}
+
+// Timelines for every start, from one backward sweep. A beam that leaves
+// the last row is one timeline, and one that leaves row r - 1 in column w
+// has the timelines of the beams it becomes in row r:
+//   T(r - 1, w) = splitter at (r, w) ? T(r, w - 1) + T(r, w + 1) : T(r, w)
+// Every row of the sweep is a branch-free pass over the columns, with the
+// splitters as masks, that vectorizes. Only the first row of T is kept
+// unless all_rows is asked for.
+class timeline_table {
+public:
+  timeline_table(std::span<const std::string_view> rows, bool all_rows)
+      : _width(rows.front().size()), _n_rows(all_rows ? rows.size() : 1),
+        _table(_n_rows * (_width + 2), 0) {
+    // rows of T, with a zero on either side
+    std::vector<int64_t> below(_width + 2, 1);
+    below.front() = below.back() = 0;
+    std::vector<int64_t> above(_width + 2, 0);
+    std::vector<int64_t> masks(_width, 0);
+    for (auto r = rows.size() - 1; r > 0; --r) {
+      keep(r, below);
+      const auto row = rows[r];
+      for (auto w = 0uz; w < _width; ++w) {
+        masks[w] = -static_cast<int64_t>(w < row.size() && row[w] == SPLIT_C);
+      }
+      for (auto w = 0uz; w < _width; ++w) {
+        above[w + 1] = (below[w + 1] & ~masks[w]) |
+                       ((below[w] + below[w + 2]) & masks[w]);
+      }
+      std::swap(below, above);
+    }
+    keep(0, below);
+  }
+
+  // Timelines of a beam leaving row in column
+  int64_t at(std::size_t row, std::size_t column) const {
+    assert(row < _n_rows && column < _width);
+    return _table[row * (_width + 2) + column + 1];
+  }
+  std::size_t width() const { return _width; }
+
+private:
+  void keep(std::size_t row, std::span<const int64_t> timelines) {
+    if (row < _n_rows) {
+      std::ranges::copy(timelines, _table.begin() + static_cast<std::ptrdiff_t>(
+                                                        row * (_width + 2)));
+    }
   }
-  assert(full_input.size() % manifold_width == 0);
-  const auto manifold_height = full_input.size() / manifold_width;
-  const auto manifold =
-      std::mdspan(full_input.data(), manifold_height, manifold_width);
-  const auto start_it =
-      std::find(full_input.cbegin(), full_input.cend(), START_C);
-  const auto start_index =
-      static_cast<std::size_t>(std::distance(full_input.cbegin(), start_it));
-  // Part 1
-  std::vector<bool> beams(manifold_width, false);
-  auto new_beams = beams;
-  beams[start_index] = true;
-  int64_t beam_splits{0};
-  // Part 2
-  std::vector<int64_t> timelines(manifold_width, 0);
-  auto new_timelines = timelines;
-  timelines[start_index] = 1;
-
-  // Solutions Part 1 and Part 2
-  for (auto h = 1uz; h < manifold_height; ++h) {
-    for (auto w = 0uz; w < manifold_width; ++w) {
-      if (beams[w] && is_splitter(manifold[h, w])) {
-        // Part 1
-        new_beams[w] = false;
-        new_beams[w - 1] = new_beams[w + 1] = true;
-        ++beam_splits;
-        // Part 2
-        new_timelines[w] = 0;
-        new_timelines[w - 1] += timelines[w];
-        new_timelines[w + 1] += timelines[w];
+
+  std::size_t _width;
+  std::size_t _n_rows;
+  std::vector<int64_t> _table;
+};
+
+// Same as solve, reading the rows from stream as they come: a thread reads
+// the next block of rows while the current one is propagated, and only two
+// blocks and the state, all O(width), are held at once
+template <class State>
+static std::pair<int64_t, int64_t> solve_streamed(line_stream &stream) {
+  std::optional<State> state;
+  std::string block(stream.next());
+  std::string next_block;
+  while (!block.empty()) {
+    std::thread reader([&stream, &next_block]() {
+      next_block.assign(stream.next());
+    });
+    for (auto row : lines(block)) {
+      if (row.empty()) {
+        continue;
+      }
+      if (state) {
+        state->advance(row);
       } else {
-        new_beams[w] = beams[w] || new_beams[w];
-        new_timelines[w] = timelines[w] + new_timelines[w];
+        state.emplace(row);
+      }
+    }
+    reader.join();
+    std::swap(block, next_block);
+  }
+  assert(state);
+  return {state->splits(), state->timelines()};
+}
+
+int main(int argc, char *argv[]) {
+  std::println("Ciao, {}!", "Mondo");
+  const std::vector<std::string_view> options(argv + 1, argv + argc);
+  // --sparse follows the lit columns only, for wide manifolds with few beams
+  const bool sparse = std::ranges::find(options, "--sparse") != options.end();
+  // --stream reads the rows from a pipe as they come, in O(width) memory
+  const bool stream = std::ranges::find(options, "--stream") != options.end();
+  // --all-starts also counts the timelines of a beam starting in any column
+  // of the first row, --all-rows in any cell, from one backward sweep over
+  // the buffered input
+  const bool all_starts =
+      std::ranges::find(options, "--all-starts") != options.end();
+  const bool all_rows =
+      std::ranges::find(options, "--all-rows") != options.end();
+  if (stream && (all_starts || all_rows)) {
+    std::println(stderr, "--all-starts and --all-rows need the whole input, "
+                         "they do not work with --stream");
+    return EXIT_FAILURE;
+  }
+  phase_timer timer;
+  std::pair<int64_t, int64_t> solutions;
+  if (stream) {
+    line_stream rows_stream(STDIN_FILENO);
+    solutions = sparse ? solve_streamed<sparse_beam_state>(rows_stream)
+                       : solve_streamed<beam_state>(rows_stream);
+    timer.lap("solve");
+  } else {
+    // Parse input
+    input_buffer input;
+    std::vector<std::string_view> rows;
+    for (auto line : lines(input.view())) {
+      if (!line.empty()) {
+        rows.push_back(line);
+      }
+    }
+    assert(!rows.empty());
+    timer.lap("parse");
+
+    // Solutions Part 1 and Part 2
+    solutions =
+        sparse ? solve<sparse_beam_state>(rows) : solve<beam_state>(rows);
+    timer.lap("solve");
+
+    if (all_starts || all_rows) {
+      const timeline_table table(rows, all_rows);
+      timer.lap("table");
+      // the best start of the first row, or of the whole manifold
+      std::array<std::size_t, 2> best{0, 0};
+      for (auto row = 0uz; row < (all_rows ? rows.size() : 1); ++row) {
+        for (auto column = 0uz; column < table.width(); ++column) {
+          if (table.at(row, column) > table.at(best[0], best[1])) {
+            best = {row, column};
+          }
+        }
       }
+      std::println("Most timelines: {} from row {}, column {}",
+                   table.at(best[0], best[1]), best[0], best[1]);
+      assert(table.at(0, rows.front().find(START_C)) == solutions.second);
     }
-    std::swap(beams, new_beams);
-    std::ranges::fill(new_beams, false);
-    std::swap(timelines, new_timelines);
-    std::ranges::fill(new_timelines, 0);
   }
+  const auto [beam_splits, total_timelines] = solutions;
 
   std::println("Solution part 1: {}", beam_splits);
-  std::println("Solution part 2: {}",
-               std::ranges::fold_left(timelines, 0, std::plus()));
+  std::println("Solution part 2: {}", total_timelines);
 }
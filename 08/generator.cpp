@@ -0,0 +1,129 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <print>
+#include <queue>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+using vec3_t = std::array<int64_t, 3>;
+
+const uint64_t MIN_BOXES = 200; // so that 1000 connections do not join all
+const uint64_t BOX_BYTES = 18;  // about, with the newline
+const int64_t N_CONNECTIONS = 1000;
+
+// Junction boxes uniformly spread in a cube. The cube grows with the number
+// of boxes, so that their distances stay distinct, but squared distances and
+// products of coordinates stay inside an int64_t.
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  rng_t rng(seed);
+  const auto n_boxes = std::max(size / BOX_BYTES, MIN_BOXES);
+  const auto side = std::clamp<int64_t>(
+      static_cast<int64_t>(std::cbrt(static_cast<double>(n_boxes)) * 1000),
+      100'000, 1'000'000'000);
+  for (auto i = 0uz; i < n_boxes; ++i) {
+    out << rng.uniform(0, side - 1) << ',' << rng.uniform(0, side - 1) << ','
+        << rng.uniform(0, side - 1) << '\n';
+  }
+}
+
+static int64_t distance(const vec3_t &a, const vec3_t &b) {
+  int64_t d{0};
+  for (auto i = 0uz; i < a.size(); ++i) {
+    d += (a[i] - b[i]) * (a[i] - b[i]);
+  }
+  return d;
+}
+
+static std::size_t find(std::vector<std::size_t> &parent, std::size_t i) {
+  while (parent[i] != i) {
+    i = parent[i] = parent[parent[i]];
+  }
+  return i;
+}
+
+// Part 1 keeps the N_CONNECTIONS shortest pairs in a bounded max-heap and
+// joins them. Part 2 is the longest edge of the minimum spanning tree, the
+// last one Kruskal would add, found with the O(n^2) version of Prim.
+static void reference(std::string_view input) {
+  std::vector<vec3_t> boxes;
+  for (vec3_t box{}; read_tuple(input, box);) {
+    boxes.push_back(box);
+  }
+  const auto n = boxes.size();
+
+  using pair_t = std::pair<int64_t, std::pair<std::size_t, std::size_t>>;
+  std::priority_queue<pair_t> shortest;
+  for (auto i = 0uz; i < n; ++i) {
+    for (auto j = i + 1; j < n; ++j) {
+      shortest.emplace(distance(boxes[i], boxes[j]), std::pair(i, j));
+      if (std::ssize(shortest) > N_CONNECTIONS) {
+        shortest.pop();
+      }
+    }
+  }
+  std::vector<std::size_t> parent(n);
+  std::vector<uint64_t> sizes(n, 1);
+  for (auto i = 0uz; i < n; ++i) {
+    parent[i] = i;
+  }
+  for (; !shortest.empty(); shortest.pop()) {
+    const auto [a, b] = shortest.top().second;
+    const auto root_a = find(parent, a);
+    const auto root_b = find(parent, b);
+    if (root_a != root_b) {
+      parent[root_b] = root_a;
+      sizes[root_a] += sizes[root_b];
+    }
+  }
+  std::vector<uint64_t> circuits;
+  for (auto i = 0uz; i < n; ++i) {
+    if (parent[i] == i) {
+      circuits.push_back(sizes[i]);
+    }
+  }
+  std::ranges::sort(circuits, std::ranges::greater());
+  circuits.resize(3, 1);
+  const auto result_1 = circuits[0] * circuits[1] * circuits[2];
+
+  std::vector<int64_t> cost(n, std::numeric_limits<int64_t>::max());
+  std::vector<std::size_t> nearest(n, 0);
+  std::vector<bool> in_tree(n, false);
+  std::pair<int64_t, std::pair<std::size_t, std::size_t>> longest{-1, {0, 0}};
+  cost[0] = 0;
+  for (auto step = 0uz; step < n; ++step) {
+    auto next = n;
+    for (auto i = 0uz; i < n; ++i) {
+      if (!in_tree[i] && (next == n || cost[i] < cost[next])) {
+        next = i;
+      }
+    }
+    in_tree[next] = true;
+    if (step > 0) {
+      longest = std::max(longest, {cost[next], {nearest[next], next}});
+    }
+    for (auto i = 0uz; i < n; ++i) {
+      const auto d = distance(boxes[next], boxes[i]);
+      if (!in_tree[i] && d < cost[i]) {
+        cost[i] = d;
+        nearest[i] = next;
+      }
+    }
+  }
+  const auto [a, b] = longest.second;
+  const auto result_2 = boxes[a][0] * boxes[b][0];
+  std::println("Solution part 1: {}", result_1);
+  std::println("Solution part 2: {}", result_2);
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
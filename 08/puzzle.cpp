@@ -1,32 +1,28 @@
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
-#include <iostream>
 #include <iterator>
+#include <limits>
 #include <mdspan>
 #include <numeric>
+#include <optional>
 #include <print>
 #include <span>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
-// input reading taken from:
-// https://marcoarena.wordpress.com/2016/03/13/cpp-competitive-programming-io/
-struct custom_delims : std::ctype<char> {
-  custom_delims() : ctype<char>(make_table()) {}
-
-  static const mask *make_table() {
-    static mask table[ctype<char>::table_size];
-    table[' '] = table[','] = table['\n'] = ctype_base::space;
-    return &table[0];
-  }
-};
+#include "bench.h"
+#include "fast_input.h"
+#include "parallel.h"
 
 using cord_t = int64_t;
 using vec3_t = std::array<cord_t, 3>;
@@ -64,7 +60,7 @@ public:
 
   std::vector<std::size_t> get_sets_sizes() {
     std::vector<std::size_t> result;
-    for (auto &set : _sets) {
+    for (auto set = 0uz; set < _sets.size(); ++set) {
       if (set == _sets[set]) { // root of a set
         result.push_back(_sizes[set]);
       }
@@ -130,33 +126,394 @@ struct connection_t {
   }
 };
 
-int main() {
+// k-d tree over the boxes, stored implicitly: the boxes are reordered so
+// that every node is a contiguous range of them, split at its middle box on
+// the axis given by its depth: the boxes before the middle one are not above
+// it on that axis and the boxes after it are not below.
+class kd_tree {
+public:
+  // (distance, box) pairs, compared by distance then by box
+  using neighbour_t = std::pair<int64_t, std::size_t>;
+
+  explicit kd_tree(std::span<const vec3_t> boxes) {
+    for (auto i = 0uz; i < boxes.size(); ++i) {
+      _nodes.emplace_back(boxes[i], i);
+    }
+    _splits.resize(_nodes.size());
+    build(0, _nodes.size(), 0);
+  }
+
+  // The k boxes nearest to box, box itself left out, nearest first
+  std::vector<neighbour_t> nearest(const vec3_t &box, std::size_t self,
+                                   std::size_t k) const {
+    std::vector<neighbour_t> best; // max-heap of the k best so far
+    search(0, _nodes.size(), 0, box, self, k, best);
+    std::ranges::sort_heap(best);
+    return best;
+  }
+
+  // Euclidean minimum spanning tree of the boxes, by Boruvka rounds: every
+  // box looks for its nearest box in another component, concurrently, every
+  // component joins the nearest one found by its boxes, until one is left.
+  // Subtrees within the component of a box are skipped whole, thanks to a
+  // label per node telling the component all its boxes are in, if any, and
+  // so are those further than the shortest connection the component has
+  // found so far.
+  // Connections are ordered by (distance, jbox1, jbox2), which makes the
+  // tree unique and the same as Kruskal's. They are returned in that order.
+  std::vector<connection_t> minimum_spanning_tree() const {
+    const auto n = _nodes.size();
+    std::vector<connection_t> tree;
+    std::vector<std::size_t> components(n);
+    std::iota(components.begin(), components.end(), 0);
+    std::vector<std::size_t> labels(n, NO_LABEL);
+    std::vector<connection_t> nearest(n);
+    std::vector<connection_t> best(n);
+    std::vector<std::size_t> parents(n);
+    // shortest connection found so far by every component, the boxes of a
+    // component need not look further
+    std::vector<std::atomic<int64_t>> bounds(n);
+    while (tree.size() + 1 < n) {
+      label(0, n, components, labels);
+      for (auto &bound : bounds) {
+        bound.store(std::numeric_limits<int64_t>::max(),
+                    std::memory_order_relaxed);
+      }
+      const auto n_tasks = n_workers(n, 1uz << 12);
+      parallel_for(n_tasks, [&](std::size_t task) {
+        for (auto i = n * task / n_tasks; i < n * (task + 1) / n_tasks; ++i) {
+          const auto &node = _nodes[i];
+          auto &found = nearest[node.id];
+          auto &bound = bounds[components[node.id]];
+          found = {n, n, std::numeric_limits<int64_t>::max()};
+          search_foreign(0, n, 0, node, components, labels, bound, found);
+          for (auto shortest = bound.load(std::memory_order_relaxed);
+               found.distance < shortest &&
+               !bound.compare_exchange_weak(shortest, found.distance,
+                                            std::memory_order_relaxed);) {
+          }
+        }
+      });
+      // the nearest connection of every component, kept at its label
+      std::ranges::fill(best, connection_t{n, n, 0});
+      for (auto box = 0uz; box < n; ++box) {
+        auto &current = best[components[box]];
+        if (current.jbox1 == n || key(nearest[box]) < key(current)) {
+          current = nearest[box];
+        }
+      }
+      // two components may pick the same connection
+      std::iota(parents.begin(), parents.end(), 0);
+      auto find = [&parents](std::size_t c) {
+        while (parents[c] != c) {
+          c = parents[c] = parents[parents[c]];
+        }
+        return c;
+      };
+      for (const auto &connection : best) {
+        if (connection.jbox1 == n) {
+          continue;
+        }
+        const auto c1 = find(components[connection.jbox1]);
+        const auto c2 = find(components[connection.jbox2]);
+        if (c1 != c2) {
+          parents[std::max(c1, c2)] = std::min(c1, c2);
+          tree.push_back(connection);
+        }
+      }
+      for (auto &component : components) {
+        component = find(component);
+      }
+    }
+    std::ranges::sort(tree, {}, key);
+    return tree;
+  }
+
+private:
+  static constexpr std::size_t LEAF_SIZE = 8;
+  static constexpr std::size_t NO_LABEL =
+      std::numeric_limits<std::size_t>::max();
+
+  static std::tuple<int64_t, std::size_t, std::size_t>
+  key(const connection_t &connection) {
+    return {connection.distance, connection.jbox1, connection.jbox2};
+  }
+
+  struct node_t {
+    vec3_t box;
+    std::size_t id;
+  };
+
+  void build(std::size_t begin, std::size_t end, std::size_t depth) {
+    if (end - begin <= LEAF_SIZE) {
+      return;
+    }
+    const auto mid = std::midpoint(begin, end);
+    const auto axis = depth % 3;
+    auto at = [this](std::size_t i) {
+      return _nodes.begin() + static_cast<std::ptrdiff_t>(i);
+    };
+    std::ranges::nth_element(
+        at(begin), at(mid), at(end), {},
+        [axis](const node_t &node) { return node.box[axis]; });
+    // the children move the middle box around, its coordinate stays here
+    _splits[mid] = _nodes[mid].box[axis];
+    build(begin, mid, depth + 1);
+    build(mid, end, depth + 1);
+  }
+
+  void search(std::size_t begin, std::size_t end, std::size_t depth,
+              const vec3_t &box, std::size_t self, std::size_t k,
+              std::vector<neighbour_t> &best) const {
+    if (end - begin <= LEAF_SIZE) {
+      for (const auto &node : std::span(_nodes).subspan(begin, end - begin)) {
+        const neighbour_t candidate{distance(box, node.box), node.id};
+        if (node.id == self) {
+          continue;
+        }
+        if (best.size() < k) {
+          best.push_back(candidate);
+          std::ranges::push_heap(best);
+        } else if (candidate < best.front()) {
+          std::ranges::pop_heap(best);
+          best.back() = candidate;
+          std::ranges::push_heap(best);
+        }
+      }
+      return;
+    }
+    const auto mid = std::midpoint(begin, end);
+    const auto axis = depth % 3;
+    const auto gap = box[axis] - _splits[mid];
+    if (gap < 0) {
+      search(begin, mid, depth + 1, box, self, k, best);
+    } else {
+      search(mid, end, depth + 1, box, self, k, best);
+    }
+    // the other side is at least gap away
+    if (best.size() < k || gap * gap <= best.front().first) {
+      if (gap < 0) {
+        search(mid, end, depth + 1, box, self, k, best);
+      } else {
+        search(begin, mid, depth + 1, box, self, k, best);
+      }
+    }
+  }
+
+  // Set the label of every node of [begin, end) to the component all its
+  // boxes are in, or NO_LABEL, and return the label of the node. Like the
+  // splits, node data is kept at the index of the middle box, which no two
+  // nodes share.
+  std::size_t label(std::size_t begin, std::size_t end,
+                    std::span<const std::size_t> components,
+                    std::span<std::size_t> labels) const {
+    const auto mid = std::midpoint(begin, end);
+    auto result = components[_nodes[begin].id];
+    if (end - begin <= LEAF_SIZE) {
+      for (const auto &node : std::span(_nodes).subspan(begin, end - begin)) {
+        if (components[node.id] != result) {
+          result = NO_LABEL;
+        }
+      }
+    } else {
+      const auto left = label(begin, mid, components, labels);
+      const auto right = label(mid, end, components, labels);
+      result = left == right ? left : NO_LABEL;
+    }
+    labels[mid] = result;
+    return result;
+  }
+
+  // Lower nearest to the shortest connection from from.box to a box of
+  // [begin, end) in another component, not further than bound
+  void search_foreign(std::size_t begin, std::size_t end, std::size_t depth,
+                      const node_t &from,
+                      std::span<const std::size_t> components,
+                      std::span<const std::size_t> labels,
+                      const std::atomic<int64_t> &bound,
+                      connection_t &nearest) const {
+    const auto mid = std::midpoint(begin, end);
+    const auto component = components[from.id];
+    if (labels[mid] == component) {
+      return;
+    }
+    if (end - begin <= LEAF_SIZE) {
+      for (const auto &node : std::span(_nodes).subspan(begin, end - begin)) {
+        if (components[node.id] == component) {
+          continue;
+        }
+        const auto [box1, box2] = std::minmax(from.id, node.id);
+        const connection_t candidate{box1, box2, distance(from.box, node.box)};
+        if (key(candidate) < key(nearest)) {
+          nearest = candidate;
+        }
+      }
+      return;
+    }
+    const auto axis = depth % 3;
+    const auto gap = from.box[axis] - _splits[mid];
+    if (gap < 0) {
+      search_foreign(begin, mid, depth + 1, from, components, labels, bound,
+                     nearest);
+    } else {
+      search_foreign(mid, end, depth + 1, from, components, labels, bound,
+                     nearest);
+    }
+    if (gap * gap <= std::min(nearest.distance,
+                              bound.load(std::memory_order_relaxed))) {
+      if (gap < 0) {
+        search_foreign(mid, end, depth + 1, from, components, labels, bound,
+                       nearest);
+      } else {
+        search_foreign(begin, mid, depth + 1, from, components, labels, bound,
+                       nearest);
+      }
+    }
+  }
+
+  std::vector<node_t> _nodes;
+  // split coordinate of every inner node, at the index of its middle box
+  std::vector<cord_t> _splits;
+};
+
+// Connections between boxes by increasing distance, generated lazily
+// instead of all O(n^2) of them: every box keeps its nearest neighbours,
+// found with a k-d tree, and a heap holds the next neighbour every box has
+// not yet used. When a box has used all of its neighbours, twice as many
+// are looked up, so the memory is O(n k) for the k neighbours a box really
+// needs. A pair is given by the box with the lower index, ties in distance
+// going to the lower indices.
+class connection_stream {
+public:
+  // The neighbours are first looked up on all cores
+  connection_stream(std::span<const vec3_t> boxes, const kd_tree &tree,
+                    std::size_t first_neighbours = 8)
+      : _boxes(boxes), _tree(tree), _neighbours(boxes.size()) {
+    const auto n_tasks = n_workers(boxes.size(), 1uz << 12);
+    parallel_for(n_tasks, [&](std::size_t task) {
+      for (auto box = boxes.size() * task / n_tasks;
+           box < boxes.size() * (task + 1) / n_tasks; ++box) {
+        _neighbours[box] = _tree.nearest(boxes[box], box, first_neighbours);
+      }
+    });
+    for (auto box = 0uz; box < boxes.size(); ++box) {
+      push(box, 0);
+    }
+  }
+
+  // The next connection, if any is left
+  std::optional<connection_t> next() {
+    while (!_heap.empty()) {
+      std::ranges::pop_heap(_heap, std::ranges::greater{});
+      const auto [distance, box, rank] = _heap.back();
+      _heap.pop_back();
+      const auto other = _neighbours[box][rank].second;
+      if (rank + 1 == _neighbours[box].size() &&
+          _neighbours[box].size() + 1 < _boxes.size()) {
+        _neighbours[box] =
+            _tree.nearest(_boxes[box], box, 2 * _neighbours[box].size());
+      }
+      push(box, rank + 1);
+      if (box < other) {
+        return connection_t{box, other, distance};
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  // Make the neighbour of box at rank its next candidate, if there is one
+  void push(std::size_t box, std::size_t rank) {
+    if (rank < _neighbours[box].size()) {
+      _heap.emplace_back(_neighbours[box][rank].first, box, rank);
+      std::ranges::push_heap(_heap, std::ranges::greater{});
+    }
+  }
+
+  std::span<const vec3_t> _boxes;
+  const kd_tree &_tree;
+  std::vector<std::vector<kd_tree::neighbour_t>> _neighbours;
+  // (distance, box, rank in the neighbours of box), a min-heap
+  std::vector<std::tuple<int64_t, std::size_t, std::size_t>> _heap;
+};
+
+int main(int argc, char *argv[]) {
   std::println("Ciao, {}!", "Mondo");
+  const std::vector<std::string_view> options(argv + 1, argv + argc);
+  // --all-pairs heapifies all the O(n^2) connections instead of generating
+  // them lazily from a k-d tree
+  const bool all_pairs =
+      std::ranges::find(options, "--all-pairs") != options.end();
   // Parse input
-  std::cin.imbue(std::locale(std::cin.getloc(), new custom_delims()));
+  phase_timer timer;
+  input_buffer input;
+  std::string_view text = input.view();
   std::vector<vec3_t> boxes;
-  while (std::cin >> std::ws) {
-    boxes.push_back({});
-    for (cord_t &cord : boxes.back()) {
-      std::cin >> cord >> std::ws;
-    }
+  for (vec3_t box{}; read_tuple(text, box);) {
+    boxes.push_back(box);
   }
+  timer.lap("parse");
   const auto n_boxes = std::size(boxes);
   // Each box is identified by its position in the vector `boxes`
   // connection_t stores the distance between two boxes
   std::vector<connection_t> connections;
-  for (auto box1 = 0uz; box1 < n_boxes; ++box1) {
-    for (auto box2 = box1 + 1; box2 < n_boxes; ++box2) {
-      connections.emplace_back(box1, box2, distance(boxes[box1], boxes[box2]));
+  if (all_pairs) {
+    for (auto box1 = 0uz; box1 < n_boxes; ++box1) {
+      for (auto box2 = box1 + 1; box2 < n_boxes; ++box2) {
+        connections.emplace_back(box1, box2,
+                                 distance(boxes[box1], boxes[box2]));
+      }
     }
   }
-  auto heap = min_heap(connections, &connection_t::distance);
+  auto heap = min_heap(std::move(connections), &connection_t::distance);
+  std::optional<kd_tree> tree;
+  std::optional<connection_stream> stream;
+  if (!all_pairs) {
+    tree.emplace(boxes);
+    stream.emplace(boxes, *tree);
+  }
+  // The next shortest connection, if any is left
+  auto next_connection = [&heap, &stream]() -> std::optional<connection_t> {
+    if (stream) {
+      return stream->next();
+    }
+    if (heap.empty()) {
+      return std::nullopt;
+    }
+    return *heap.pop_min();
+  };
   // make each junction box a circuit on its own
   union_find circuits(n_boxes);
 
+  timer.lap("connections");
+
+  // The minimum spanning tree, for part 2 and part 1 alike: of the first
+  // 1000 connections, those that join two circuits are exactly its edges
+  // up to the last of the 1000
+  std::vector<connection_t> spanning_tree;
+  if (tree) {
+    spanning_tree = tree->minimum_spanning_tree();
+    timer.lap("spanning tree");
+  }
+
   // Solution Part 1
+  std::optional<connection_t> last_of_first;
   for (auto i = 0; i < 1000; ++i) {
-    circuits.merge_sets(*heap.pop_min());
+    if (const auto connection = next_connection()) {
+      last_of_first = connection;
+      if (!tree) {
+        circuits.merge_sets(*connection);
+      }
+    }
+  }
+  for (const auto &edge : spanning_tree) {
+    if (!last_of_first ||
+        std::tuple(edge.distance, edge.jbox1, edge.jbox2) >
+            std::tuple(last_of_first->distance, last_of_first->jbox1,
+                       last_of_first->jbox2)) {
+      break;
+    }
+    circuits.merge_sets(edge);
   }
   auto circuits_sizes = circuits.get_sets_sizes();
   std::ranges::sort(circuits_sizes, std::ranges::greater{});
@@ -164,18 +521,31 @@ int main() {
       std::accumulate(circuits_sizes.cbegin(), circuits_sizes.cbegin() + 3, 1uz,
                       std::multiplies<std::size_t>());
 
-  // Solution Part 2
-  decltype(heap.pop_min()) last_connection_it;
-  uint64_t last_set_size = 0;
-  while (!heap.empty() && last_set_size != n_boxes) {
-    last_connection_it = heap.pop_min();
-    last_set_size = circuits.merge_sets(*last_connection_it);
-  }
+  timer.lap("part 1");
 
-  assert(last_set_size == n_boxes);
-  auto [box1, box2, _d] = *last_connection_it;
+  // Solution Part 2: the last connection Kruskal makes, the longest edge of
+  // the spanning tree
+  connection_t last_connection{};
+  if (tree) {
+    assert(spanning_tree.size() + 1 == n_boxes);
+    last_connection = spanning_tree.back();
+  } else {
+    uint64_t last_set_size = 0;
+    while (last_set_size != n_boxes) {
+      const auto connection = next_connection();
+      if (!connection) {
+        break;
+      }
+      last_connection = *connection;
+      last_set_size = circuits.merge_sets(last_connection);
+    }
+    assert(last_set_size == n_boxes);
+  }
+  auto [box1, box2, _d] = last_connection;
   auto result_2 = std::get<0>(boxes[box1]) * std::get<0>(boxes[box2]);
 
+  timer.lap("part 2");
+
   std::println("Solution part 1: {}", result_1);
   std::println("Solution part 2: {}", result_2);
 }
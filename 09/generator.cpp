@@ -0,0 +1,199 @@
+// Input generator and reference solver, see ../common/generator.h
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <print>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+using vec2_t = std::array<int64_t, 2>;
+
+const uint64_t TILE_BYTES = 14; // about, with the newline
+const int64_t MEAN_EXTENT = 50'000;
+// Steps stay random at any size, the polygon growing past MEAN_EXTENT instead
+const int64_t MIN_MAX_STEP = 16;
+
+// Steps of one of the four staircases of the polygon
+class staircase_t {
+public:
+  staircase_t(uint64_t seed, uint64_t steps, int64_t max_step)
+      : _seed(seed), _steps(steps), _max_step(max_step) {}
+
+  // Call f(dx, dy) for every step, always in the same order
+  template <class F> void for_each_step(F f) const {
+    rng_t rng(_seed);
+    for (auto i = 0uz; i < _steps; ++i) {
+      const auto dy = rng.uniform(1, _max_step);
+      f(rng.uniform(1, _max_step), dy);
+    }
+  }
+  uint64_t size() const { return _steps; }
+  // Total width and height
+  vec2_t extent() const {
+    vec2_t total{0, 0};
+    for_each_step([&total](int64_t dx, int64_t dy) {
+      total[0] += dx;
+      total[1] += dy;
+    });
+    return total;
+  }
+
+private:
+  uint64_t _seed;
+  uint64_t _steps;
+  int64_t _max_step;
+};
+
+// An orthogonally convex polygon, listed counterclockwise from its east
+// corner: staircases from east to north, north to west, west to south and
+// south to east, each step a vertical move followed by a horizontal one.
+// The last two staircases are the first two turned by half a turn, so the
+// polygon closes, and they are replayed from their seeds instead of stored.
+static void generate(uint64_t seed, uint64_t size, output_buffer &out) {
+  const auto steps = std::max<uint64_t>(size / (8 * TILE_BYTES), 1);
+  const auto max_step =
+      std::max(2 * MEAN_EXTENT / static_cast<int64_t>(steps), MIN_MAX_STEP);
+  const staircase_t first(hash64(seed, 0), steps, max_step);
+  const staircase_t second(hash64(seed, 1), steps, max_step);
+  const auto [dx1, dy1] = first.extent();
+  const auto [dx2, dy2] = second.extent();
+
+  vec2_t tile{dx1 + dx2, dy2}; // east corner
+  out << tile[0] << ',' << tile[1] << '\n';
+  auto walk = [&tile, &out](const staircase_t &stairs, int64_t sx,
+                            int64_t sy, bool last) {
+    auto left = stairs.size();
+    stairs.for_each_step([&](int64_t dx, int64_t dy) {
+      tile[1] += sy * dy;
+      out << tile[0] << ',' << tile[1] << '\n';
+      tile[0] += sx * dx;
+      if (--left > 0 || !last) { // the very last move is back to the start
+        out << tile[0] << ',' << tile[1] << '\n';
+      }
+    });
+  };
+  walk(first, -1, 1, false);
+  walk(second, -1, -1, false);
+  walk(first, 1, -1, false);
+  walk(second, 1, 1, true);
+}
+
+static int64_t rectangle_area(vec2_t p, vec2_t q) {
+  return (1 + std::abs(p[0] - q[0])) * (1 + std::abs(p[1] - q[1]));
+}
+
+// The tiles of row y that are red, green or inside the polygon, as sorted
+// disjoint [first, last] runs. A vertical edge is crossed when one of its
+// ends is at or below y and the other above, so the runs between pairs of
+// crossings are inside; the horizontal edges on y are added on top.
+static std::vector<vec2_t> row_runs(const std::vector<vec2_t> &tiles,
+                                    int64_t y) {
+  std::vector<int64_t> crossings;
+  std::vector<vec2_t> runs;
+  for (auto i = 0uz; i < tiles.size(); ++i) {
+    const auto &p = tiles[i];
+    const auto &q = tiles[(i + 1) % tiles.size()];
+    if (p[0] == q[0] && (p[1] <= y) != (q[1] <= y)) {
+      crossings.push_back(p[0]);
+    } else if (p[1] == q[1] && p[1] == y) {
+      runs.push_back({std::min(p[0], q[0]), std::max(p[0], q[0])});
+    }
+  }
+  std::ranges::sort(crossings);
+  for (auto i = 0uz; i + 1 < crossings.size(); i += 2) {
+    runs.push_back({crossings[i], crossings[i + 1]});
+  }
+  std::ranges::sort(runs);
+  std::vector<vec2_t> merged;
+  for (const auto &run : runs) {
+    if (!merged.empty() && run[0] <= merged.back()[1] + 1) {
+      merged.back()[1] = std::max(merged.back()[1], run[1]);
+    } else {
+      merged.push_back(run);
+    }
+  }
+  return merged;
+}
+
+// Part 1 tries every pair of red tiles. For part 2 the rows of the red tiles,
+// and one row for every gap between them, which all look the same, are cut
+// in runs of coloured tiles. From every red tile the rows are walked upwards
+// while its column stays coloured, narrowing the run of columns coloured in
+// every row so far, and every red tile met inside that run closes a valid
+// rectangle. Memory is linear in the number of tiles for the orthogonally
+// convex polygons that are generated, time quadratic.
+static void reference(std::string_view input) {
+  std::vector<vec2_t> tiles;
+  for (vec2_t tile{}; read_tuple(input, tile);) {
+    tiles.push_back(tile);
+  }
+  const auto n = tiles.size();
+
+  int64_t result_1{0};
+  for (auto i = 0uz; i < n; ++i) {
+    for (auto j = i + 1; j < n; ++j) {
+      result_1 = std::max(result_1, rectangle_area(tiles[i], tiles[j]));
+    }
+  }
+
+  std::vector<int64_t> ys;
+  for (const auto &tile : tiles) {
+    ys.push_back(tile[1]);
+  }
+  std::ranges::sort(ys);
+  ys.erase(std::ranges::unique(ys).begin(), ys.end());
+  std::vector<int64_t> rows;
+  for (auto i = 0uz; i < ys.size(); ++i) {
+    rows.push_back(ys[i]);
+    if (i + 1 < ys.size() && ys[i] + 1 < ys[i + 1]) {
+      rows.push_back(ys[i] + 1);
+    }
+  }
+  std::vector<std::vector<vec2_t>> runs;
+  std::vector<std::vector<int64_t>> red_columns(rows.size());
+  for (const auto y : rows) {
+    runs.push_back(row_runs(tiles, y));
+  }
+  auto row_of = [&rows](int64_t y) {
+    return static_cast<std::size_t>(std::ranges::lower_bound(rows, y) -
+                                    rows.begin());
+  };
+  for (const auto &tile : tiles) {
+    red_columns[row_of(tile[1])].push_back(tile[0]);
+  }
+
+  int64_t result_2{0};
+  for (const auto &tile : tiles) {
+    vec2_t columns{tile[0], tile[0]};
+    bool first_row = true;
+    for (auto r = row_of(tile[1]); r < rows.size(); ++r) {
+      const auto &row = runs[r];
+      const auto run = std::ranges::upper_bound(
+          row, tile[0], {}, [](const vec2_t &run) { return run[0]; });
+      if (run == row.begin() || std::prev(run)->at(1) < tile[0]) {
+        break;
+      }
+      const auto [first, last] = *std::prev(run);
+      columns = first_row ? vec2_t{first, last}
+                          : vec2_t{std::max(columns[0], first),
+                                   std::min(columns[1], last)};
+      first_row = false;
+      for (const auto x : red_columns[r]) {
+        if (columns[0] <= x && x <= columns[1]) {
+          result_2 = std::max(result_2, rectangle_area(tile, {x, rows[r]}));
+        }
+      }
+    }
+  }
+  std::println("Solution part 1: {}", result_1);
+  std::println("Solution part 2: {}", result_2);
+}
+
+int main(int argc, char *argv[]) {
+  return generator_main(argc, argv, generate, reference);
+}
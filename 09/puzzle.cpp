@@ -4,7 +4,6 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
-#include <iostream>
 #include <iterator>
 #include <map>
 #include <mdspan>
@@ -12,21 +11,13 @@
 #include <set>
 #include <span>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
-// input reading taken from:
-// https://marcoarena.wordpress.com/2016/03/13/cpp-competitive-programming-io/
-struct custom_delims : std::ctype<char> {
-  custom_delims() : ctype<char>(make_table()) {}
-
-  static const mask *make_table() {
-    static mask table[ctype<char>::table_size];
-    table[' '] = table[','] = table['\n'] = ctype_base::space;
-    return &table[0];
-  }
-};
+#include "bench.h"
+#include "fast_input.h"
 
 using u64 = uint64_t;
 using i64 = int64_t;
@@ -229,15 +220,16 @@ private:
 int main() {
   std::println("Ciao, {}!", "Mondo");
   // Parse input
-  std::cin.imbue(std::locale(std::cin.getloc(), new custom_delims()));
+  phase_timer timer;
+  input_buffer input;
+  std::string_view text = input.view();
   std::vector<vec2_t> red_tiles;
-  while (std::cin >> std::ws) {
-    red_tiles.push_back({});
-    for (cord_t &cord : red_tiles.back()) {
-      std::cin >> cord >> std::ws;
-    }
+  for (vec2_t tile{}; read_tuple(text, tile);) {
+    red_tiles.push_back(tile);
   }
 
+  timer.lap("parse");
+
   // Solution Part 1
   auto result_1 = 0L;
   for (auto p = red_tiles.cbegin(); p != red_tiles.cend(); ++p) {
@@ -248,6 +240,8 @@ int main() {
     }
   }
 
+  timer.lap("part 1");
+
   // Solution Part 2
   auto cc_map = compressed_coordintes_mapper(red_tiles);
   auto compress_vec2_t = [&cc_map](vec2_t point) -> vec2_t {
@@ -292,6 +286,8 @@ int main() {
     }
   }
 
+  timer.lap("part 2");
+
   std::println("Solution part 1: {}", result_1);
   std::println("Solution part 2: {}", result_2);
 }
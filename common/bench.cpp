@@ -0,0 +1,226 @@
+// Benchmark driver behind `make bench`.
+//
+//   bench [-n runs] [-w warmup] [-j json_file] ./main input...
+//
+// Runs the solver on every input, as stdin, warmup times untimed and then
+// runs times, and reports min, median and p99 wall time of every phase the
+// solver's phase_timer reports (see bench.h) and of the whole run, plus
+// throughput and peak resident set size. The report is printed in human
+// readable form and, with -j, also written as JSON.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const int BENCH_FD = 3;
+
+struct run_t {
+  std::vector<std::pair<std::string, double>> phases; // nanoseconds
+  double total_ns;
+  int64_t max_rss_bytes;
+};
+
+struct stats_t {
+  double min_ns;
+  double median_ns;
+  double p99_ns;
+};
+
+static stats_t compute_stats(std::vector<double> samples) {
+  std::ranges::sort(samples);
+  // nearest rank percentile
+  auto percentile = [&samples](double p) {
+    const auto rank = static_cast<std::size_t>(
+        std::ceil(p / 100 * static_cast<double>(samples.size())));
+    return samples[std::clamp<std::size_t>(rank, 1, samples.size()) - 1];
+  };
+  return {samples.front(), percentile(50), percentile(99)};
+}
+
+// Run command once with stdin read from input, return its phases and usage
+static run_t run_once(const char *command, const std::string &input) {
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) {
+    std::println(stderr, "bench: cannot create a pipe");
+    std::exit(EXIT_FAILURE);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const pid_t pid = fork();
+  if (pid == 0) {
+    const int input_fd = open(input.c_str(), O_RDONLY);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    if (input_fd < 0 || null_fd < 0) {
+      _exit(127);
+    }
+    dup2(input_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(pipe_fds[1], BENCH_FD);
+    setenv("AOC_BENCH_FD", std::to_string(BENCH_FD).c_str(), 1);
+    execl(command, command, static_cast<char *>(nullptr));
+    _exit(127);
+  }
+  close(pipe_fds[1]);
+  std::string report;
+  char buffer[4096];
+  for (ssize_t n; (n = read(pipe_fds[0], buffer, sizeof(buffer))) > 0;) {
+    report.append(buffer, static_cast<std::size_t>(n));
+  }
+  close(pipe_fds[0]);
+  int status{0};
+  rusage usage{};
+  wait4(pid, &status, 0, &usage);
+  const auto end = std::chrono::steady_clock::now();
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::println(stderr, "bench: {} failed on {}", command, input);
+    std::exit(EXIT_FAILURE);
+  }
+
+  run_t run{{}, std::chrono::duration<double, std::nano>(end - start).count(),
+            usage.ru_maxrss};
+#ifndef __APPLE__
+  run.max_rss_bytes *= 1024; // kilobytes everywhere but on macOS
+#endif
+  std::string_view lines = report;
+  while (!lines.empty()) {
+    const auto eol = std::min(lines.find('\n'), lines.size());
+    const auto line = lines.substr(0, eol);
+    lines.remove_prefix(std::min(eol + 1, lines.size()));
+    const auto space = line.rfind(' ');
+    if (space == std::string_view::npos) {
+      continue;
+    }
+    int64_t ns{0};
+    std::from_chars(line.data() + space + 1, line.data() + line.size(), ns);
+    run.phases.emplace_back(std::string(line.substr(0, space)),
+                            static_cast<double>(ns));
+  }
+  return run;
+}
+
+static std::string json_string(std::string_view s) {
+  std::string result = "\"";
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      result.push_back('\\');
+    }
+    result.push_back(c);
+  }
+  return result + "\"";
+}
+
+static std::string json_stats(const stats_t &stats) {
+  return std::format(
+      R"({{"min_ns": {:.0f}, "median_ns": {:.0f}, "p99_ns": {:.0f}}})",
+      stats.min_ns, stats.median_ns, stats.p99_ns);
+}
+
+int main(int argc, char *argv[]) {
+  int runs{10};
+  int warmup{2};
+  std::string json_file;
+  int arg{1};
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    const std::string_view option = argv[arg];
+    if (option == "-n") {
+      runs = std::max(1, std::atoi(argv[arg + 1]));
+    } else if (option == "-w") {
+      warmup = std::max(0, std::atoi(argv[arg + 1]));
+    } else if (option == "-j") {
+      json_file = argv[arg + 1];
+    } else {
+      break;
+    }
+  }
+  if (argc - arg < 2) {
+    std::println(stderr,
+                 "usage: {} [-n runs] [-w warmup] [-j json_file] "
+                 "./main input...",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+  const char *command = argv[arg++];
+
+  std::string json = "[";
+  for (; arg < argc; ++arg) {
+    const std::string input = argv[arg];
+    const auto bytes = std::filesystem::file_size(input);
+    for (int i = 0; i < warmup; ++i) {
+      run_once(command, input);
+    }
+    std::vector<run_t> results;
+    for (int i = 0; i < runs; ++i) {
+      results.push_back(run_once(command, input));
+    }
+
+    // phases in the order the solver reports them
+    std::vector<std::pair<std::string, std::vector<double>>> phases;
+    std::vector<double> totals;
+    int64_t peak_rss{0};
+    for (const auto &run : results) {
+      for (const auto &[name, ns] : run.phases) {
+        auto phase = std::ranges::find(phases, name,
+                                       [](auto &p) { return p.first; });
+        if (phase == phases.end()) {
+          phases.emplace_back(name, std::vector<double>{});
+          phase = std::prev(phases.end());
+        }
+        phase->second.push_back(ns);
+      }
+      totals.push_back(run.total_ns);
+      peak_rss = std::max(peak_rss, run.max_rss_bytes);
+    }
+    const auto total = compute_stats(totals);
+    const auto bytes_per_second =
+        static_cast<double>(bytes) / (total.median_ns * 1e-9);
+
+    std::println("{} ({} bytes, {} runs after {} warm-up)", input, bytes, runs,
+                 warmup);
+    std::println("  {:<12} {:>12} {:>12} {:>12}", "phase", "min ms",
+                 "median ms", "p99 ms");
+    auto print_row = [](std::string_view name, const stats_t &stats) {
+      std::println("  {:<12} {:>12.3f} {:>12.3f} {:>12.3f}", name,
+                   stats.min_ns * 1e-6, stats.median_ns * 1e-6,
+                   stats.p99_ns * 1e-6);
+    };
+    std::string json_phases;
+    for (const auto &[name, samples] : phases) {
+      const auto stats = compute_stats(samples);
+      print_row(name, stats);
+      json_phases += std::format("{}{}: {}", json_phases.empty() ? "" : ", ",
+                                 json_string(name), json_stats(stats));
+    }
+    print_row("total", total);
+    std::println("  throughput   {:.1f} MB/s", bytes_per_second * 1e-6);
+    std::println("  peak RSS     {:.1f} MiB",
+                 static_cast<double>(peak_rss) / (1 << 20));
+
+    json += std::format(
+        R"({}{{"input": {}, "bytes": {}, "runs": {}, "warmup": {}, )"
+        R"("phases": {{{}}}, "total": {}, "bytes_per_second": {:.0f}, )"
+        R"("peak_rss_bytes": {}}})",
+        json.size() > 1 ? ", " : "", json_string(input), bytes, runs, warmup,
+        json_phases, json_stats(total), bytes_per_second, peak_rss);
+  }
+  json += "]\n";
+  if (!json_file.empty()) {
+    std::ofstream(json_file) << json;
+  }
+}
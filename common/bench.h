@@ -0,0 +1,64 @@
+#pragma once
+// Phase timing for `make bench`.
+// When the AOC_BENCH_FD environment variable is set, a phase_timer sends the
+// wall time of every phase of the run to that file descriptor, one
+// "<phase> <nanoseconds>" line each, when it is destroyed. Otherwise lap() is
+// a no-op and nothing is written.
+
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+class phase_timer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  phase_timer() : _fd(fd_from_env()), _last(clock::now()) {}
+  phase_timer(const phase_timer &) = delete;
+  phase_timer &operator=(const phase_timer &) = delete;
+  ~phase_timer() {
+    if (_fd < 0) {
+      return;
+    }
+    std::string report;
+    for (const auto &[phase, duration] : _laps) {
+      std::format_to(std::back_inserter(report), "{} {}\n", phase,
+                     duration.count());
+    }
+    auto to_write = std::string_view(report);
+    while (!to_write.empty()) {
+      const auto written = write(_fd, to_write.data(), to_write.size());
+      if (written <= 0) {
+        break;
+      }
+      to_write.remove_prefix(static_cast<std::size_t>(written));
+    }
+  }
+
+  // End the current phase, calling it `phase`, and start the next one
+  void lap(std::string_view phase) {
+    if (_fd < 0) {
+      return;
+    }
+    const auto now = clock::now();
+    _laps.emplace_back(phase, now - _last);
+    _last = now;
+  }
+
+private:
+  static int fd_from_env() {
+    const char *fd = std::getenv("AOC_BENCH_FD");
+    return fd ? std::atoi(fd) : -1;
+  }
+
+  int _fd;
+  clock::time_point _last;
+  std::vector<std::pair<std::string, std::chrono::nanoseconds>> _laps;
+};
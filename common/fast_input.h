@@ -0,0 +1,342 @@
+#pragma once
+// Input helpers shared by the puzzles.
+// The whole input is one byte span, mapped when stdin is a regular file and
+// read in bulk otherwise, and it is parsed in place: lines and fields are
+// std::string_views into it and numbers are read with std::from_chars, so
+// there is no locale, no virtual call and no allocation per token.
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only view of a file descriptor when it is a regular file. Stays empty
+// when it is a pipe or a terminal, in which case the input has to be streamed.
+class mapped_input {
+public:
+  explicit mapped_input(int fd = STDIN_FILENO) {
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+      return;
+    }
+    void *addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                      MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      return;
+    }
+    madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+    _data = std::string_view(static_cast<const char *>(addr),
+                             static_cast<std::size_t>(st.st_size));
+  }
+  mapped_input(const mapped_input &) = delete;
+  mapped_input &operator=(const mapped_input &) = delete;
+  ~mapped_input() {
+    if (!_data.empty()) {
+      munmap(const_cast<char *>(_data.data()), _data.size());
+    }
+  }
+
+  bool empty() const { return _data.empty(); }
+  std::string_view view() const { return _data; }
+
+  // Let the kernel drop the pages of part, a piece of view(), that are done
+  // with: the page holding the end of part is kept, as the next piece may
+  // need it. A dropped page is read again from the file if touched.
+  void release(std::string_view part) const {
+    const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    const auto begin =
+        reinterpret_cast<uintptr_t>(part.data()) & ~(page_size - 1);
+    const auto end =
+        reinterpret_cast<uintptr_t>(part.data() + part.size()) &
+        ~(page_size - 1);
+    if (begin < end) {
+      madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+    }
+  }
+
+private:
+  std::string_view _data;
+};
+
+// read(2) that is retried when interrupted by a signal: the number of bytes
+// read, 0 at the end of the input. Throws on any other error.
+inline std::size_t read_some(int fd, char *data, std::size_t size) {
+  while (true) {
+    const auto n_read = read(fd, data, size);
+    if (n_read >= 0) {
+      return static_cast<std::size_t>(n_read);
+    }
+    if (errno != EINTR) {
+      throw std::system_error(errno, std::generic_category(), "read");
+    }
+  }
+}
+
+// The whole input: mapped when possible, otherwise read in bulk
+class input_buffer {
+public:
+  explicit input_buffer(int fd = STDIN_FILENO) : _mapped(fd) {
+    if (!_mapped.empty()) {
+      return;
+    }
+    const std::size_t block_size = 1 << 16;
+    std::size_t n_read{0};
+    do {
+      const auto size = _data.size();
+      _data.resize(size + block_size);
+      n_read = read_some(fd, _data.data() + size, block_size);
+      _data.resize(size + n_read);
+    } while (n_read > 0);
+  }
+
+  bool is_mapped() const { return !_mapped.empty(); }
+  std::string_view view() const {
+    return is_mapped() ? _mapped.view() : std::string_view(_data);
+  }
+  // See mapped_input::release, nothing happens when the input was read
+  void release(std::string_view part) const {
+    if (is_mapped()) {
+      _mapped.release(part);
+    }
+  }
+
+private:
+  mapped_input _mapped;
+  std::string _data;
+};
+
+// The input a block of whole lines at a time, for inputs that do not fit in
+// memory: only about one block is held at once.
+class line_stream {
+public:
+  explicit line_stream(int fd = STDIN_FILENO, std::size_t block_size = 1 << 20)
+      : _fd(fd), _block_size(block_size) {}
+
+  // The next complete lines, newlines included, or an empty view at the end
+  // of the input. The view is valid until the next call.
+  std::string_view next() {
+    _buffer.erase(0, _consumed);
+    fill(_block_size);
+    auto end = _buffer.size();
+    if (!_eof) {
+      // a line longer than a block makes the buffer grow
+      while ((end = _buffer.rfind('\n')) == std::string::npos && !_eof) {
+        fill(2 * _buffer.size());
+      }
+      end = end == std::string::npos ? _buffer.size() : end + 1;
+    }
+    _consumed = end;
+    return std::string_view(_buffer).substr(0, end);
+  }
+
+private:
+  // Read until the buffer holds size bytes or the input ends
+  void fill(std::size_t size) {
+    while (!_eof && _buffer.size() < size) {
+      const auto old_size = _buffer.size();
+      _buffer.resize(size);
+      const auto n_read =
+          read_some(_fd, _buffer.data() + old_size, size - old_size);
+      _buffer.resize(old_size + n_read);
+      _eof = n_read == 0;
+    }
+  }
+
+  int _fd;
+  std::size_t _block_size;
+  std::string _buffer;
+  std::size_t _consumed{0};
+  bool _eof{false};
+};
+
+// SWAR (SIMD within a register) scanning: 8 bytes are compared at once
+namespace swar {
+const uint64_t ONES = 0x0101010101010101ull;
+const uint64_t HIGH_BITS = 0x8080808080808080ull;
+
+inline uint64_t load(const char *p) {
+  uint64_t chunk;
+  std::memcpy(&chunk, p, sizeof(chunk));
+  return chunk;
+}
+
+// High bit set in the bytes of chunk equal to c. Bytes above the first match
+// may be wrongly flagged, the lowest flag is always exact.
+inline uint64_t equal_bytes(uint64_t chunk, char c) {
+  const auto v = chunk ^ (ONES * static_cast<unsigned char>(c));
+  return (v - ONES) & ~v & HIGH_BITS;
+}
+} // namespace swar
+
+// First character in [it, end) that is one of delimiters, or end
+inline const char *find_any_of(const char *it, const char *end,
+                               std::string_view delimiters) {
+  if (delimiters.size() == 1) {
+    const auto found = std::memchr(it, delimiters[0],
+                                   static_cast<std::size_t>(end - it));
+    return found ? static_cast<const char *>(found) : end;
+  }
+  if constexpr (std::endian::native == std::endian::little) {
+    for (; end - it >= 8; it += 8) {
+      const auto chunk = swar::load(it);
+      uint64_t matches{0};
+      for (const char delimiter : delimiters) {
+        matches |= swar::equal_bytes(chunk, delimiter);
+      }
+      if (matches != 0) {
+        return it + std::countr_zero(matches) / 8;
+      }
+    }
+  }
+  return std::find_first_of(it, end, delimiters.begin(), delimiters.end());
+}
+
+// Pieces of text separated by any of the delimiters, as a range of
+// std::string_view. With skip_empty, runs of delimiters count as one, as with
+// operator>> on whitespace; without it the text after the last delimiter is
+// still left out when empty, so that a final newline adds no empty line.
+class split_view {
+public:
+  class iterator {
+  public:
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    iterator(const split_view *parent, const char *it)
+        : _parent(parent), _next(it) {
+      ++*this;
+    }
+
+    std::string_view operator*() const { return _piece; }
+    iterator &operator++() {
+      const char *end = _parent->_text.data() + _parent->_text.size();
+      do {
+        if (_next == end) {
+          _done = true;
+          return *this;
+        }
+        const char *piece_end = find_any_of(_next, end, _parent->_delimiters);
+        _piece = std::string_view(_next, piece_end);
+        _next = piece_end == end ? end : piece_end + 1;
+      } while (_parent->_skip_empty && _piece.empty());
+      return *this;
+    }
+    iterator operator++(int) {
+      auto old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(std::default_sentinel_t) const { return _done; }
+
+  private:
+    const split_view *_parent{nullptr};
+    const char *_next{nullptr};
+    std::string_view _piece;
+    bool _done{false};
+  };
+
+  split_view(std::string_view text, std::string_view delimiters,
+             bool skip_empty)
+      : _text(text), _delimiters(delimiters), _skip_empty(skip_empty) {}
+
+  iterator begin() const { return iterator(this, _text.data()); }
+  std::default_sentinel_t end() const { return {}; }
+
+private:
+  std::string_view _text;
+  std::string_view _delimiters;
+  bool _skip_empty;
+};
+
+// Lines of text, without their newline. Empty lines are kept.
+inline split_view lines(std::string_view text) {
+  return split_view(text, "\n", false);
+}
+
+// Fields of a line separated by runs of any of the delimiters
+inline split_view fields(std::string_view line,
+                         std::string_view delimiters = " ") {
+  return split_view(line, delimiters, true);
+}
+
+// Read the next non-negative integer at or after `it`, skipping whatever is
+// not a digit before it. Return false when there is none left.
+template <std::integral T>
+bool read_int(const char *&it, const char *end, T &value) {
+  it = std::find_if(it, end, [](char c) { return c >= '0' && c <= '9'; });
+  if (it == end) {
+    return false;
+  }
+  it = std::from_chars(it, end, value).ptr;
+  return true;
+}
+
+template <std::integral T> bool read_int(std::string_view &text, T &value) {
+  const char *it = text.data();
+  const bool found = read_int(it, text.data() + text.size(), value);
+  text.remove_prefix(static_cast<std::size_t>(it - text.data()));
+  return found;
+}
+
+// Read N integers, e.g. the coordinates in "162,817,812"
+template <std::integral T, std::size_t N>
+bool read_tuple(std::string_view &text, std::array<T, N> &tuple) {
+  return std::ranges::all_of(
+      tuple, [&text](T &value) { return read_int(text, value); });
+}
+
+// All the integers in text
+template <std::integral T> std::vector<T> read_ints(std::string_view text) {
+  std::vector<T> values;
+  T value{};
+  while (read_int(text, value)) {
+    values.push_back(value);
+  }
+  return values;
+}
+
+// Split text in n_chunks pieces of about the same size, each ending right
+// after a delimiter (or at the end of text), to be parsed concurrently
+inline std::vector<std::string_view>
+split_chunks(std::string_view text, std::size_t n_chunks, char delimiter) {
+  std::vector<std::string_view> chunks;
+  auto begin = 0uz;
+  for (auto i = 1uz; i <= n_chunks && begin < text.size(); ++i) {
+    auto end = text.size();
+    if (i != n_chunks) {
+      const auto cut = std::max(begin, text.size() * i / n_chunks);
+      end = std::min(text.find(delimiter, cut), text.size() - 1) + 1;
+    }
+    chunks.push_back(text.substr(begin, end - begin));
+    begin = end;
+  }
+  return chunks;
+}
+
+// Decimal representation of a 128-bit value, for the sums that outgrow
+// int64_t: std::format does not take __int128
+inline std::string to_string_128(unsigned __int128 value) {
+  std::string v;
+  do {
+    v.push_back(static_cast<char>('0' + static_cast<int>(value % 10)));
+    value /= 10;
+  } while (value != 0);
+  std::ranges::reverse(v);
+  return v;
+}
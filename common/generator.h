@@ -0,0 +1,143 @@
+#pragma once
+// Helpers for the per-day input generators (NN/generator.cpp).
+// Every generator has two commands:
+//
+//   generator generate <seed> <size>   writes about size bytes of puzzle input
+//                                      (K, M and G suffixes allowed) to stdout
+//   generator reference                solves the puzzle on stdin the slow and
+//                                      obvious way, printing the same
+//                                      "Solution part N: " lines as main
+//
+// Output is produced as a stream, through a fixed size buffer, so inputs can
+// be much larger than memory. The same seed and size give the same input.
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <print>
+#include <string>
+#include <string_view>
+
+#include "fast_input.h"
+
+// splitmix64 finaliser, a good 64-bit mix of x
+constexpr uint64_t mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Random value number i of the stream seed, for generators that need to
+// revisit values without storing them
+constexpr uint64_t hash64(uint64_t seed, uint64_t i) {
+  return mix64(mix64(seed) ^ i);
+}
+
+// Sequential pseudo random generator (splitmix64)
+class rng_t {
+public:
+  explicit rng_t(uint64_t seed) : _state(seed) {}
+
+  uint64_t next() {
+    _state += 0x9E3779B97F4A7C15ull;
+    return mix64(_state);
+  }
+  // Uniform in [lo, hi]
+  int64_t uniform(int64_t lo, int64_t hi) {
+    const auto span = static_cast<uint64_t>(hi - lo) + 1;
+    return lo + static_cast<int64_t>(span == 0 ? next() : next() % span);
+  }
+  // True with probability numerator / denominator
+  bool chance(uint64_t numerator, uint64_t denominator) {
+    return next() % denominator < numerator;
+  }
+
+private:
+  uint64_t _state;
+};
+
+// Buffered writer to stdout
+class output_buffer {
+public:
+  output_buffer() { _buffer.reserve(BUFFER_SIZE); }
+  output_buffer(const output_buffer &) = delete;
+  output_buffer &operator=(const output_buffer &) = delete;
+  ~output_buffer() { flush(); }
+
+  output_buffer &operator<<(std::string_view s) {
+    _buffer.append(s);
+    _written += s.size();
+    if (_buffer.size() >= BUFFER_SIZE) {
+      flush();
+    }
+    return *this;
+  }
+  output_buffer &operator<<(char c) { return *this << std::string_view(&c, 1); }
+  output_buffer &operator<<(int64_t value) {
+    char digits[24];
+    const auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    return *this << std::string_view(digits, end);
+  }
+
+  // Bytes written so far
+  uint64_t size() const { return _written; }
+
+  void flush() {
+    std::fwrite(_buffer.data(), 1, _buffer.size(), stdout);
+    _buffer.clear();
+  }
+
+private:
+  static constexpr std::size_t BUFFER_SIZE = 1 << 20;
+  std::string _buffer;
+  uint64_t _written{0};
+};
+
+// Parse sizes like 4096, 64K, 10M or 20G
+inline uint64_t parse_size(std::string_view text) {
+  uint64_t value{0};
+  const auto [end, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  switch (end == text.data() + text.size() ? '\0' : *end) {
+  case 'G':
+  case 'g':
+    value <<= 10;
+    [[fallthrough]];
+  case 'M':
+  case 'm':
+    value <<= 10;
+    [[fallthrough]];
+  case 'K':
+  case 'k':
+    value <<= 10;
+    break;
+  default:
+    break;
+  }
+  return std::max(value, uint64_t{1});
+}
+
+// Entry point shared by the generators.
+// generate(seed, size, out) writes an input, reference(input) solves one.
+template <class Generate, class Reference>
+int generator_main(int argc, char *argv[], Generate generate,
+                   Reference reference) {
+  const std::string_view command = argc > 1 ? argv[1] : "";
+  if (command == "generate" && argc == 4) {
+    output_buffer out;
+    generate(std::strtoull(argv[2], nullptr, 10), parse_size(argv[3]), out);
+    return EXIT_SUCCESS;
+  }
+  if (command == "reference" && argc == 2) {
+    input_buffer input;
+    reference(input.view());
+    return EXIT_SUCCESS;
+  }
+  std::println(stderr, "usage: {} generate <seed> <size>", argv[0]);
+  std::println(stderr, "       {} reference < input", argv[0]);
+  return EXIT_FAILURE;
+}
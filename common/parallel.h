@@ -0,0 +1,34 @@
+#pragma once
+// Fork-join helpers shared by the puzzles.
+// A parallel_for starts one thread per task and runs the first task on the
+// calling thread, and n_workers picks how many tasks are worth starting.
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Run task(i) for every i in [0, n_tasks), each on its own thread
+template <class F> void parallel_for(std::size_t n_tasks, F task) {
+  std::vector<std::thread> workers;
+  for (auto i = 1uz; i < n_tasks; ++i) {
+    workers.emplace_back([&task, i]() { task(i); });
+  }
+  if (n_tasks > 0) {
+    task(0);
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// One worker per core
+inline std::size_t n_workers() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Workers for work_size items, each worth at least min_work_size of them
+inline std::size_t n_workers(std::size_t work_size,
+                             std::size_t min_work_size) {
+  return std::clamp<std::size_t>(work_size / min_work_size, 1, n_workers());
+}